@@ -22,6 +22,15 @@ AZMQ_V1_INLINE_NAMESPACE_BEGIN
     using max_sockets = detail::context_ops::max_sockets;
     using ipv6 = detail::context_ops::ipv6;
 
+    /** \brief io_service option selecting the Linux epoll reactor
+     *  \remark When set, sockets subsequently opened on the io_service have
+     *  their ZMQ_FD registered with a single edge triggered epoll instance
+     *  shared by the io_service, instead of each being waited on through
+     *  asio. Setting it where epoll is unavailable fails with
+     *  operation_not_supported.
+     */
+    using use_epoll_reactor = detail::socket_service::use_epoll_reactor;
+
     /** \brief set options on the zeromq context.
      *  \tparam Option option type
      *  \param option Option option to set
@@ -69,6 +78,14 @@ AZMQ_V1_INLINE_NAMESPACE_BEGIN
         if (get_option(io_service, option))
             throw boost::system::system_error(ec);
     }
+
+    /** \brief totals of the counters of all sockets opened on io_service
+     *  \remark Includes sockets which have since been closed. Does not take
+     *  any socket's lock.
+     */
+    inline detail::socket_stats get_socket_stats(boost::asio::io_service & io_service) {
+        return boost::asio::use_service<detail::socket_service>(io_service).stats();
+    }
 AZMQ_V1_INLINE_NAMESPACE_END
 } // namespace azmq
 #endif // AZMQ_CONTEXT_HPP_
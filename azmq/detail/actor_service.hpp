@@ -79,8 +79,8 @@ namespace detail {
         }
 
     private:
-        struct concept {
-            using ptr = std::shared_ptr<concept>;
+        struct actor_concept {
+            using ptr = std::shared_ptr<actor_concept>;
 
             boost::asio::io_service io_service_;
             boost::asio::signal_set signals_;
@@ -94,7 +94,7 @@ namespace detail {
             bool stopped_;
             std::exception_ptr last_error_;
 
-            concept()
+            actor_concept()
                 : signals_(io_service_, SIGINT, SIGTERM)
                 , socket_(io_service_)
                 , ready_(false)
@@ -103,7 +103,7 @@ namespace detail {
                 socket_.bind(get_uri("pipe"));
             }
 
-            virtual ~concept() = default;
+            virtual ~actor_concept() = default;
 
 #ifdef AZMQ_DETAIL_USE_IO_SERVICE
             pair_socket peer_socket(boost::asio::io_service & peer) {
@@ -181,7 +181,7 @@ namespace detail {
         };
 
         template<typename Function>
-        struct model : concept {
+        struct model : actor_concept {
             Function data_;
 
             model(Function data)
@@ -192,10 +192,10 @@ namespace detail {
         };
 
         struct handler {
-            concept::ptr p_;
+            actor_concept::ptr p_;
             bool defer_start_;
 
-            handler(concept::ptr p, bool defer_start)
+            handler(actor_concept::ptr p, bool defer_start)
                 : p_(std::move(p))
                 , defer_start_(defer_start)
             { }
@@ -203,7 +203,7 @@ namespace detail {
             void on_install(boost::asio::io_service&, void*) {
                 if (defer_start_) return;
                 defer_start_ = false;
-                concept::run(p_);
+                actor_concept::run(p_);
             }
 
             void on_remove() {
@@ -228,7 +228,7 @@ namespace detail {
                     {
                         if (*static_cast<start::value_t const*>(opt.data()) && defer_start_) {
                             defer_start_ = false;
-                            concept::run(p_);
+                            actor_concept::run(p_);
                         }
                     }
                     break;
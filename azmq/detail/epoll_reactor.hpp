@@ -0,0 +1,265 @@
+/*
+    Copyright (c) 2013-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of azmq
+
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef AZMQ_DETAIL_EPOLL_REACTOR_HPP_
+#define AZMQ_DETAIL_EPOLL_REACTOR_HPP_
+
+#if defined(__linux__) && !defined(AZMQ_DISABLE_EPOLL_REACTOR)
+#   define AZMQ_DETAIL_HAS_EPOLL_REACTOR 1
+#endif
+
+#ifdef AZMQ_DETAIL_HAS_EPOLL_REACTOR
+#include <boost/version.hpp>
+#include <boost/assert.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+
+#if BOOST_VERSION < 10700
+#   define AZMQ_DETAIL_USE_IO_SERVICE 1
+#else
+#   include <boost/asio/post.hpp>
+#endif
+#include <boost/system/error_code.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#include <sys/epoll.h>
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+namespace azmq {
+namespace detail {
+    /** \brief single epoll instance shared by all of an io_service's sockets
+     *  \remark Each socket's ZMQ_FD is added once, edge triggered, for the
+     *  lifetime of the socket. Only the epoll descriptor itself is known to
+     *  asio, so there is one asio wait outstanding per io_service rather than
+     *  one per socket, and no re-arm is needed after a socket wakes up. Ready
+     *  sockets are handed in batches to the dispatch function supplied at
+     *  construction.
+     *
+     *  The asio wait is only kept outstanding while at least one registration
+     *  is active (its socket has ops queued), so that an io_service with no
+     *  pending socket operations still runs out of work.
+     */
+    class epoll_reactor : public std::enable_shared_from_this<epoll_reactor> {
+    public:
+        using target_type = std::weak_ptr<void>;
+        using dispatch_func = void(*)(std::shared_ptr<void> const&);
+
+        /** \brief RAII handle for a descriptor added to an epoll_reactor */
+        class registration {
+        public:
+            registration() = default;
+
+            registration(std::weak_ptr<epoll_reactor> reactor, uint64_t id, int fd)
+                : reactor_(std::move(reactor))
+                , id_(id)
+                , fd_(fd)
+            { }
+
+            registration(registration && other)
+                : reactor_(std::move(other.reactor_))
+                , id_(other.id_)
+                , fd_(other.fd_)
+                , active_(other.active_)
+            {
+                other.reactor_.reset();
+                other.active_ = false;
+            }
+
+            registration& operator=(registration && rhs) {
+                if (this != &rhs) {
+                    reset();
+                    reactor_ = std::move(rhs.reactor_);
+                    id_ = rhs.id_;
+                    fd_ = rhs.fd_;
+                    active_ = rhs.active_;
+                    rhs.reactor_.reset();
+                    rhs.active_ = false;
+                }
+                return *this;
+            }
+
+            registration(registration const&) = delete;
+            registration& operator=(registration const&) = delete;
+
+            ~registration() { reset(); }
+
+            explicit operator bool() const { return !reactor_.expired(); }
+
+            /** \brief mark whether the registered descriptor needs to be watched */
+            void set_active(bool active) {
+                if (active == active_)
+                    return;
+                active_ = active;
+                if (auto r = reactor_.lock()) {
+                    if (active)
+                        r->arm();
+                    else
+                        r->disarm();
+                }
+            }
+
+            void reset() {
+                set_active(false);
+                if (auto r = reactor_.lock())
+                    r->remove(id_, fd_);
+                reactor_.reset();
+            }
+
+        private:
+            std::weak_ptr<epoll_reactor> reactor_;
+            uint64_t id_ = 0;
+            int fd_ = -1;
+            bool active_ = false;
+        };
+
+        static std::shared_ptr<epoll_reactor> create(boost::asio::io_service & ios,
+                                                     dispatch_func dispatch,
+                                                     boost::system::error_code & ec) {
+            auto fd = ::epoll_create1(EPOLL_CLOEXEC);
+            if (fd < 0) {
+                ec = boost::system::error_code(errno, boost::system::system_category());
+                return nullptr;
+            }
+            return std::shared_ptr<epoll_reactor>(new epoll_reactor(ios, fd, dispatch));
+        }
+
+        epoll_reactor(epoll_reactor const&) = delete;
+        epoll_reactor& operator=(epoll_reactor const&) = delete;
+
+        /** \brief add fd, edge triggered, on behalf of target
+         *  \remark target is passed to the dispatch function each time fd becomes
+         *  readable, for as long as both it and the returned registration live.
+         */
+        registration add(int fd, target_type target, boost::system::error_code & ec) {
+            lock_type l{ mutex_ };
+            auto id = ++last_id_;
+            targets_.emplace(id, std::move(target));
+
+            epoll_event ev = { };
+            ev.events = EPOLLIN | EPOLLET;
+            ev.data.u64 = id;
+            if (::epoll_ctl(sd_.native_handle(), EPOLL_CTL_ADD, fd, &ev) < 0) {
+                ec = boost::system::error_code(errno, boost::system::system_category());
+                targets_.erase(id);
+                return registration();
+            }
+            return registration(shared_from_this(), id, fd);
+        }
+
+        /** \brief descriptors currently registered, for diagnostics */
+        size_t size() const {
+            lock_type l{ mutex_ };
+            return targets_.size();
+        }
+
+    private:
+        using lock_type = boost::unique_lock<boost::mutex>;
+        enum { batch_size = 64 };
+
+        epoll_reactor(boost::asio::io_service & ios, int fd, dispatch_func dispatch)
+            : sd_(ios, fd)
+            , dispatch_(dispatch)
+        { }
+
+        // completes both real wakeups and cancelled waits, either way the
+        // wait is re-armed if still required and the epoll set drained
+        struct wait_handler {
+            std::weak_ptr<epoll_reactor> owner_;
+
+            void operator()() const {
+                if (auto p = owner_.lock())
+                    p->on_ready();
+            }
+
+            void operator()(boost::system::error_code const&, size_t) const {
+                (*this)();
+            }
+        };
+
+        void arm() {
+            lock_type l{ mutex_ };
+            if (active_++ || waiting_)
+                return;
+            // events may already be sitting in the epoll set without a fresh
+            // edge to come, so drain before waiting
+            waiting_ = true;
+#ifdef AZMQ_DETAIL_USE_IO_SERVICE
+            sd_.get_io_service().post(wait_handler{ shared_from_this() });
+#else
+            boost::asio::post(sd_.get_executor(), wait_handler{ shared_from_this() });
+#endif
+        }
+
+        void disarm() {
+            lock_type l{ mutex_ };
+            BOOST_ASSERT_MSG(active_ > 0, "unbalanced disarm");
+            if (--active_ == 0 && waiting_) {
+                boost::system::error_code ec;
+                sd_.cancel(ec);
+            }
+        }
+
+        void remove(uint64_t id, int fd) {
+            lock_type l{ mutex_ };
+            epoll_event ev = { };
+            ::epoll_ctl(sd_.native_handle(), EPOLL_CTL_DEL, fd, &ev);
+            targets_.erase(id);
+        }
+
+        void on_ready() {
+            {
+                // re-arm before draining, anything which arrives after the last
+                // epoll_wait below will complete the new wait
+                lock_type l{ mutex_ };
+                waiting_ = active_ > 0;
+                if (waiting_)
+                    sd_.async_read_some(boost::asio::null_buffers(), wait_handler{ shared_from_this() });
+            }
+
+            std::array<epoll_event, batch_size> events;
+            std::array<std::shared_ptr<void>, batch_size> ready;
+            int n;
+            do {
+                size_t ct = 0;
+                {
+                    lock_type l{ mutex_ };
+                    n = ::epoll_wait(sd_.native_handle(), events.data(), batch_size, 0);
+                    for (auto i = 0; i < n; ++i) {
+                        auto it = targets_.find(events[i].data.u64);
+                        if (it == std::end(targets_))
+                            continue;
+                        if (auto p = it->second.lock())
+                            ready[ct++] = std::move(p);
+                    }
+                }
+
+                for (size_t i = 0; i != ct; ++i) {
+                    dispatch_(ready[i]);
+                    ready[i].reset();
+                }
+            } while (n == batch_size);
+        }
+
+        boost::asio::posix::stream_descriptor sd_;
+        dispatch_func dispatch_;
+        mutable boost::mutex mutex_;
+        uint64_t last_id_ = 0;
+        size_t active_ = 0;
+        bool waiting_ = false;
+        std::unordered_map<uint64_t, target_type> targets_;
+    };
+} // namespace detail
+} // namespace azmq
+#endif // AZMQ_DETAIL_HAS_EPOLL_REACTOR
+#endif // AZMQ_DETAIL_EPOLL_REACTOR_HPP_
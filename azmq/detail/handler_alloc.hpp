@@ -0,0 +1,237 @@
+/*
+    Copyright (c) 2013-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of azmq
+
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef AZMQ_DETAIL_HANDLER_ALLOC_HPP_
+#define AZMQ_DETAIL_HANDLER_ALLOC_HPP_
+
+#include <boost/version.hpp>
+#include <boost/assert.hpp>
+
+#if BOOST_VERSION >= 106600
+#   include <boost/asio/associated_allocator.hpp>
+#   define AZMQ_DETAIL_USE_ASSOCIATED_ALLOCATOR 1
+#else
+#   include <boost/asio/detail/handler_alloc_helpers.hpp>
+#endif
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+namespace azmq {
+namespace detail {
+    /** \brief lock free cache of operation storage blocks
+     *  \remark Each io_service's socket_service owns one of these. Storage
+     *  for a completed op is parked here just before its handler is invoked,
+     *  so a handler which immediately initiates another operation (the
+     *  typical receive loop) picks the same block back up without a trip to
+     *  the global allocator.
+     */
+    class op_recycler {
+    public:
+        op_recycler() {
+            for (auto& slot : cache_)
+                slot.store(nullptr, std::memory_order_relaxed);
+        }
+
+        ~op_recycler() {
+            for (auto& slot : cache_)
+                ::operator delete(slot.load(std::memory_order_relaxed));
+        }
+
+        op_recycler(op_recycler const&) = delete;
+        op_recycler& operator=(op_recycler const&) = delete;
+
+        void* allocate(std::size_t size) {
+            for (auto& slot : cache_) {
+                if (!slot.load(std::memory_order_relaxed))
+                    continue;
+
+                if (auto p = static_cast<header*>(slot.exchange(nullptr, std::memory_order_acquire))) {
+                    if (p->capacity >= size)
+                        return p + 1;
+                    ::operator delete(p);
+                }
+            }
+
+            auto capacity = round_up(size);
+            auto p = static_cast<header*>(::operator new(sizeof(header) + capacity));
+            p->capacity = capacity;
+            return p + 1;
+        }
+
+        void deallocate(void* pv) {
+            if (!pv) return;
+
+            auto p = static_cast<header*>(pv) - 1;
+            for (auto& slot : cache_) {
+                void* expected = nullptr;
+                if (slot.compare_exchange_strong(expected, p, std::memory_order_release,
+                                                              std::memory_order_relaxed))
+                    return;
+            }
+            ::operator delete(p);
+        }
+
+    private:
+        // keeps the block following the header suitably aligned for any op
+        union header {
+            std::size_t capacity;
+            long double ld_;
+            long long ll_;
+            void* pv_;
+        };
+
+        enum { granularity = 64, slots = 8 };
+
+        static std::size_t round_up(std::size_t size) {
+            return (size + granularity - 1) & ~static_cast<std::size_t>(granularity - 1);
+        }
+
+        std::array<std::atomic<void*>, slots> cache_;
+    };
+
+    /** \brief standard allocator drawing from an op_recycler
+     *  \remark Used as the associated allocator of handlers the library posts
+     *  on its own behalf, so that asio's storage for them is recycled too.
+     */
+    template<typename T>
+    class recycling_allocator {
+    public:
+        using value_type = T;
+
+        explicit recycling_allocator(op_recycler & recycler)
+            : recycler_(&recycler)
+        { }
+
+        template<typename U>
+        recycling_allocator(recycling_allocator<U> const& other)
+            : recycler_(other.recycler())
+        { }
+
+        template<typename U>
+        struct rebind {
+            using other = recycling_allocator<U>;
+        };
+
+        T* allocate(std::size_t n) {
+            return static_cast<T*>(recycler_->allocate(sizeof(T) * n));
+        }
+
+        void deallocate(T* p, std::size_t) {
+            recycler_->deallocate(p);
+        }
+
+        op_recycler * recycler() const { return recycler_; }
+
+        template<typename U>
+        bool operator==(recycling_allocator<U> const& rhs) const { return recycler_ == rhs.recycler(); }
+
+        template<typename U>
+        bool operator!=(recycling_allocator<U> const& rhs) const { return recycler_ != rhs.recycler(); }
+
+    private:
+        op_recycler * recycler_;
+    };
+
+    /** \brief obtains storage for an op from the handler's associated allocator,
+     *  or from the supplied op_recycler when the handler does not specify one.
+     *  \remark On Boost versions prior to 1.66, which predate associated
+     *  allocators, storage comes from the handler's asio_handler_allocate and
+     *  asio_handler_deallocate hooks instead.
+     */
+    template<typename Handler>
+    struct handler_alloc {
+#ifdef AZMQ_DETAIL_USE_ASSOCIATED_ALLOCATOR
+        using allocator_type = typename boost::asio::associated_allocator<Handler>::type;
+        using uses_recycler = std::is_same<allocator_type, std::allocator<void>>;
+        using char_allocator_type = typename std::allocator_traits<allocator_type>::template rebind_alloc<char>;
+
+        static void* allocate(std::size_t size, Handler const& handler, op_recycler & recycler) {
+            return allocate(size, handler, recycler, uses_recycler());
+        }
+
+        static void deallocate(void* p, std::size_t size, Handler const& handler, op_recycler & recycler) {
+            deallocate(p, size, handler, recycler, uses_recycler());
+        }
+
+    private:
+        static void* allocate(std::size_t size, Handler const&, op_recycler & recycler, std::true_type) {
+            return recycler.allocate(size);
+        }
+
+        static void* allocate(std::size_t size, Handler const& handler, op_recycler &, std::false_type) {
+            char_allocator_type a(boost::asio::get_associated_allocator(handler));
+            return std::allocator_traits<char_allocator_type>::allocate(a, size);
+        }
+
+        static void deallocate(void* p, std::size_t, Handler const&, op_recycler & recycler, std::true_type) {
+            recycler.deallocate(p);
+        }
+
+        static void deallocate(void* p, std::size_t size, Handler const& handler, op_recycler &, std::false_type) {
+            char_allocator_type a(boost::asio::get_associated_allocator(handler));
+            std::allocator_traits<char_allocator_type>::deallocate(a, static_cast<char*>(p), size);
+        }
+#else
+        static void* allocate(std::size_t size, Handler const& handler, op_recycler &) {
+            return boost_asio_handler_alloc_helpers::allocate(size, const_cast<Handler&>(handler));
+        }
+
+        static void deallocate(void* p, std::size_t size, Handler const& handler, op_recycler &) {
+            boost_asio_handler_alloc_helpers::deallocate(p, size, const_cast<Handler&>(handler));
+        }
+#endif
+    };
+
+    /** \brief true for an Op which may outlive the socket_service that created
+     *  it, and so can use neither the service's op_recycler nor storage from
+     *  the handler's allocator. make_op() allocates such an Op with plain new
+     *  and the Op deletes itself.
+     */
+    template<typename Op>
+    struct outlives_service : std::false_type { };
+
+    /** \brief allocate and construct an Op using storage obtained for handler
+     *  \remark handler is only used to select the allocator, the Op
+     *  constructor receives it (forwarded) as its last argument.
+     */
+    template<typename Op, typename Handler, typename... Args>
+    Op* make_op(op_recycler & recycler, Handler && handler, Args&&... args) {
+        if (outlives_service<Op>::value)
+            return new Op(std::forward<Args>(args)..., std::forward<Handler>(handler));
+
+        using handler_type = typename std::decay<Handler>::type;
+        auto pv = handler_alloc<handler_type>::allocate(sizeof(Op), handler, recycler);
+        try {
+            auto p = new (pv) Op(std::forward<Args>(args)..., std::forward<Handler>(handler));
+            p->recycler_ = &recycler;
+            return p;
+        } catch (...) {
+            handler_alloc<handler_type>::deallocate(pv, sizeof(Op), handler, recycler);
+            throw;
+        }
+    }
+
+    /** \brief destroy an Op created by make_op() and release its storage
+     *  \remark called from an op's completion function after the handler has
+     *  been moved out of the op and before it is invoked, which allows the
+     *  storage to be reused by any operation the handler initiates.
+     */
+    template<typename Op, typename Handler>
+    void destroy_op(Op* op, Handler const& handler) {
+        BOOST_ASSERT_MSG(op->recycler_, "op not created by make_op");
+        auto& recycler = *op->recycler_;
+        op->~Op();
+        handler_alloc<Handler>::deallocate(op, sizeof(Op), handler, recycler);
+    }
+} // namespace detail
+} // namespace azmq
+#endif // AZMQ_DETAIL_HANDLER_ALLOC_HPP_
@@ -0,0 +1,135 @@
+/*
+    Copyright (c) 2013-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of azmq
+
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef AZMQ_DETAIL_HANDLER_INVOKE_HPP_
+#define AZMQ_DETAIL_HANDLER_INVOKE_HPP_
+
+#include <boost/version.hpp>
+
+#if BOOST_VERSION >= 106600
+#   include <boost/asio/associated_allocator.hpp>
+#   include <boost/asio/associated_executor.hpp>
+#   include <boost/asio/dispatch.hpp>
+#   include <boost/asio/system_executor.hpp>
+#   define AZMQ_DETAIL_USE_ASSOCIATED_EXECUTOR 1
+#endif
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace azmq {
+namespace detail {
+    template<std::size_t... I>
+    struct index_sequence { };
+
+    template<std::size_t N, std::size_t... I>
+    struct make_index_sequence : make_index_sequence<N - 1, N - 1, I...> { };
+
+    template<std::size_t... I>
+    struct make_index_sequence<0, I...> : index_sequence<I...> { };
+
+    /** \brief nullary function object invoking Handler with stored arguments
+     *  \remark Arguments are passed as lvalues, as for a direct call from an
+     *  op's completion. Exposes the handler's associated allocator so that
+     *  asio allocates through it when the binder has to be queued.
+     */
+    template<typename Handler, typename... Args>
+    struct bound_handler {
+        Handler handler_;
+        std::tuple<Args...> args_;
+
+        explicit bound_handler(Handler handler, Args... args)
+            : handler_(std::move(handler))
+            , args_(std::move(args)...)
+        { }
+
+        void operator()() {
+            invoke(make_index_sequence<sizeof...(Args)>());
+        }
+
+#ifdef AZMQ_DETAIL_USE_ASSOCIATED_EXECUTOR
+        using allocator_type = typename boost::asio::associated_allocator<Handler>::type;
+
+        allocator_type get_allocator() const BOOST_NOEXCEPT {
+            return boost::asio::get_associated_allocator(handler_);
+        }
+#endif
+
+    private:
+        template<std::size_t... I>
+        void invoke(index_sequence<I...>) {
+            handler_(std::get<I>(args_)...);
+        }
+    };
+
+#ifdef AZMQ_DETAIL_USE_ASSOCIATED_EXECUTOR
+    template<typename Handler>
+    using has_associated_executor = std::integral_constant<bool,
+        !std::is_same<typename boost::asio::associated_executor<Handler>::type,
+                      boost::asio::system_executor>::value>;
+
+    template<typename Handler, typename... Args>
+    void dispatch_handler(Handler & handler, std::false_type, Args&&... args) {
+        handler(args...);
+    }
+
+    template<typename Handler, typename... Args>
+    void dispatch_handler(Handler & handler, std::true_type, Args&&... args) {
+        auto ex = boost::asio::get_associated_executor(handler);
+        boost::asio::dispatch(ex, bound_handler<Handler, typename std::decay<Args>::type...>(
+                                    std::move(handler), std::forward<Args>(args)...));
+    }
+
+    /** \brief call handler with args, through its associated executor if it has one
+     *  \remark Called by ops once their storage has been released. A handler
+     *  without an associated executor is called inline. One bound
+     *  to an executor, e.g. with bind_executor(strand, ...), is dispatched
+     *  to it, so it runs inline when the completion already runs in that
+     *  executor, such as a handler bound to the socket's own strand, and is
+     *  otherwise queued with args moved into the queued function object.
+     *  Handlers receive args as lvalues either way.
+     */
+    template<typename Handler, typename... Args>
+    void invoke_handler(Handler & handler, Args&&... args) {
+        dispatch_handler(handler, has_associated_executor<Handler>(), std::forward<Args>(args)...);
+    }
+
+    template<typename Handler, typename Function>
+    void run_in_handler_context(Handler const&, Function && f, std::false_type) {
+        f();
+    }
+
+    template<typename Handler, typename Function>
+    void run_in_handler_context(Handler const& handler, Function && f, std::true_type) {
+        boost::asio::dispatch(boost::asio::get_associated_executor(handler), std::forward<Function>(f));
+    }
+
+    /** \brief run f where handler's completions run
+     *  \remark For ops which call a handler they keep, rather than moving it
+     *  out; inline unless the handler has an associated executor.
+     */
+    template<typename Handler, typename Function>
+    void run_in_handler_context(Handler const& handler, Function && f) {
+        run_in_handler_context(handler, std::forward<Function>(f), has_associated_executor<Handler>());
+    }
+#else
+    template<typename Handler, typename... Args>
+    void invoke_handler(Handler & handler, Args&&... args) {
+        handler(args...);
+    }
+
+    template<typename Handler, typename Function>
+    void run_in_handler_context(Handler const&, Function && f) {
+        f();
+    }
+#endif
+} // namespace detail
+} // namespace azmq
+#endif // AZMQ_DETAIL_HANDLER_INVOKE_HPP_
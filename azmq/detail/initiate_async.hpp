@@ -0,0 +1,75 @@
+/*
+    Copyright (c) 2013-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of azmq
+
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef AZMQ_DETAIL_INITIATE_ASYNC_HPP_
+#define AZMQ_DETAIL_INITIATE_ASYNC_HPP_
+
+#include <boost/version.hpp>
+#include <boost/asio/async_result.hpp>
+
+#if BOOST_VERSION < 106600
+#   include <boost/asio/handler_type.hpp>
+#endif
+
+#include <type_traits>
+#include <utility>
+
+/** \brief return type of an initiating function taking completion token t
+ *  with completion signature sig, void for plain handlers
+ */
+#define AZMQ_INITFN_RESULT_TYPE(t, sig) BOOST_ASIO_INITFN_RESULT_TYPE(t, sig)
+
+namespace azmq {
+namespace detail {
+    /** \brief turn token into a completion handler, pass it and args to initiation
+     *  and return the token's result
+     *  \remark Forwards to asio's async_initiate where available, which is
+     *  what use_awaitable requires. Older Boost versions fall back to
+     *  async_completion, or to handler_type before that, which cover plain
+     *  handlers, use_future and yield_context. initiation is called with the
+     *  handler as an rvalue of a non-reference type.
+     */
+#if BOOST_VERSION >= 107000
+    template<typename CompletionToken, typename Signature, typename Initiation, typename... Args>
+    auto initiate_async(Initiation && initiation, CompletionToken & token, Args&&... args) ->
+        AZMQ_INITFN_RESULT_TYPE(CompletionToken, Signature) {
+        return boost::asio::async_initiate<CompletionToken, Signature>(
+                std::forward<Initiation>(initiation), token, std::forward<Args>(args)...);
+    }
+#else
+#if BOOST_VERSION >= 106600
+    template<typename CompletionToken, typename Signature>
+    using async_completion = boost::asio::async_completion<CompletionToken, Signature>;
+#else
+    template<typename CompletionToken, typename Signature>
+    struct async_completion {
+        using completion_handler_type =
+            typename boost::asio::handler_type<typename std::decay<CompletionToken>::type, Signature>::type;
+
+        explicit async_completion(CompletionToken & token)
+            : completion_handler(static_cast<CompletionToken&&>(token))
+            , result(completion_handler)
+        { }
+
+        completion_handler_type completion_handler;
+        boost::asio::async_result<completion_handler_type> result;
+    };
+#endif
+
+    template<typename CompletionToken, typename Signature, typename Initiation, typename... Args>
+    auto initiate_async(Initiation && initiation, CompletionToken & token, Args&&... args) ->
+        AZMQ_INITFN_RESULT_TYPE(CompletionToken, Signature) {
+        async_completion<CompletionToken, Signature> init(token);
+        using handler_type = typename async_completion<CompletionToken, Signature>::completion_handler_type;
+        initiation(handler_type(std::move(init.completion_handler)), std::forward<Args>(args)...);
+        return init.result.get();
+    }
+#endif
+} // namespace detail
+} // namespace azmq
+#endif // AZMQ_DETAIL_INITIATE_ASYNC_HPP_
@@ -0,0 +1,182 @@
+/*
+    Copyright (c) 2013-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of azmq
+
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef AZMQ_DETAIL_OP_TRACE_HPP_
+#define AZMQ_DETAIL_OP_TRACE_HPP_
+
+// define AZMQ_ENABLE_OP_TRACING *BEFORE* including any azmq header to have socket
+// ops timestamped at enqueue, perform and complete, see socket::op_trace_stats.
+// Nothing below is compiled otherwise.
+#ifdef AZMQ_ENABLE_OP_TRACING
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace azmq {
+namespace detail {
+    /** \brief snapshot of a latency_histogram, values in nanoseconds
+     *  \remark Buckets are log-linear, as in HdrHistogram: each power of two
+     *  range is split into sub_buckets linear buckets, so any value is known
+     *  to within 1/sub_buckets of itself.
+     */
+    struct latency_distribution {
+        enum : unsigned { sub_bucket_bits = 3 };
+        enum : uint64_t { sub_buckets = uint64_t(1) << sub_bucket_bits };
+        enum : size_t { bucket_count = (64 - sub_bucket_bits + 1) * sub_buckets };
+
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+        std::array<uint64_t, bucket_count> buckets = {{ }};
+
+        static size_t bucket_index(uint64_t v) {
+            if (v < sub_buckets)
+                return static_cast<size_t>(v);
+            unsigned msb = highest_bit(v);
+            unsigned shift = msb - sub_bucket_bits;
+            return (shift + 1) * sub_buckets + static_cast<size_t>((v >> shift) - sub_buckets);
+        }
+
+        static unsigned highest_bit(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+            return 63 - __builtin_clzll(v);
+#else
+            unsigned res = 0;
+            while (v >>= 1)
+                ++res;
+            return res;
+#endif
+        }
+
+        // largest value counted in bucket i
+        static uint64_t highest_equivalent(size_t i) {
+            if (i < sub_buckets)
+                return i;
+            auto shift = i / sub_buckets - 1;
+            auto sub = i % sub_buckets + sub_buckets;
+            return ((sub + 1) << shift) - 1;
+        }
+
+        double mean() const { return count ? static_cast<double>(sum) / count : 0.0; }
+
+        /** \brief value at or below which fraction q of the values fall
+         *  \param q double in [0, 1], 0.99 for the 99th percentile
+         */
+        uint64_t percentile(double q) const {
+            if (!count)
+                return 0;
+            auto rank = static_cast<uint64_t>(q * count + 0.5);
+            if (rank < 1) rank = 1;
+            uint64_t seen = 0;
+            for (size_t i = 0; i != bucket_count; ++i) {
+                seen += buckets[i];
+                if (seen >= rank)
+                    return highest_equivalent(i) < max ? highest_equivalent(i) : max;
+            }
+            return max;
+        }
+    };
+
+    /** \brief lock-free latency histogram
+     *  \remark record() may be called concurrently from any thread, it
+     *  does relaxed atomic increments only. A snapshot taken while values
+     *  are being recorded may be off by the values in flight.
+     */
+    class latency_histogram {
+    public:
+        latency_histogram() {
+            for (auto& b : buckets_)
+                b.store(0, std::memory_order_relaxed);
+        }
+
+        void record(uint64_t ns) {
+            buckets_[latency_distribution::bucket_index(ns)].fetch_add(1, std::memory_order_relaxed);
+            count_.fetch_add(1, std::memory_order_relaxed);
+            sum_.fetch_add(ns, std::memory_order_relaxed);
+            auto m = max_.load(std::memory_order_relaxed);
+            while (ns > m && !max_.compare_exchange_weak(m, ns, std::memory_order_relaxed)) { }
+        }
+
+        void snapshot(latency_distribution & res) const {
+            res.count = count_.load(std::memory_order_relaxed);
+            res.sum = sum_.load(std::memory_order_relaxed);
+            res.max = max_.load(std::memory_order_relaxed);
+            for (size_t i = 0; i != latency_distribution::bucket_count; ++i)
+                res.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::array<std::atomic<uint64_t>, latency_distribution::bucket_count> buckets_;
+        std::atomic<uint64_t> count_{ 0 };
+        std::atomic<uint64_t> sum_{ 0 };
+        std::atomic<uint64_t> max_{ 0 };
+    };
+
+    /** \brief per socket op timings, shared by the socket and its ops in flight
+     *  \remark queue wait is the time from enqueue until the op is performed,
+     *  completion latency the time from perform until its handler is about to
+     *  be called. Cancelled ops are never performed and are not counted.
+     */
+    class op_trace {
+    public:
+        using clock_type = std::chrono::steady_clock;
+
+        struct stats {
+            latency_distribution queue_wait;
+            latency_distribution completion;
+            uint64_t speculative_attempts = 0;
+            uint64_t speculative_hits = 0;
+
+            double speculative_hit_rate() const {
+                return speculative_attempts ? static_cast<double>(speculative_hits) / speculative_attempts
+                                            : 0.0;
+            }
+        };
+
+        static uint64_t now() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        clock_type::now().time_since_epoch()).count();
+        }
+
+        void on_speculative(bool hit) {
+            speculative_attempts_.fetch_add(1, std::memory_order_relaxed);
+            if (hit)
+                speculative_hits_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // returns the time performed, to be passed to on_complete
+        uint64_t on_perform(uint64_t enqueued_at) {
+            auto t = now();
+            queue_wait_.record(t - enqueued_at);
+            return t;
+        }
+
+        void on_complete(uint64_t performed_at) {
+            completion_.record(now() - performed_at);
+        }
+
+        void snapshot(stats & res) const {
+            queue_wait_.snapshot(res.queue_wait);
+            completion_.snapshot(res.completion);
+            res.speculative_attempts = speculative_attempts_.load(std::memory_order_relaxed);
+            res.speculative_hits = speculative_hits_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        latency_histogram queue_wait_;
+        latency_histogram completion_;
+        std::atomic<uint64_t> speculative_attempts_{ 0 };
+        std::atomic<uint64_t> speculative_hits_{ 0 };
+    };
+} // namespace detail
+} // namespace azmq
+#endif // AZMQ_ENABLE_OP_TRACING
+#endif // AZMQ_DETAIL_OP_TRACE_HPP_
@@ -11,11 +11,17 @@
 
 #include "../message.hpp"
 #include "socket_ops.hpp"
+#include "handler_alloc.hpp"
+#include "op_trace.hpp"
 
 #include <boost/optional.hpp>
 #include <boost/asio/io_service.hpp>
 #include <boost/intrusive/list.hpp>
 
+#ifdef AZMQ_ENABLE_OP_TRACING
+#   include <memory>
+#endif
+
 namespace azmq {
 namespace detail {
 class reactor_op {
@@ -25,11 +31,38 @@ public:
     boost::intrusive::list_member_hook<> member_hook_;
     boost::system::error_code ec_;
     size_t bytes_transferred_;
+    op_recycler * recycler_;
+    // set by ops which can make progress without the socket being readable or
+    // writable, they are performed at initiation whatever the speculative settings
+    bool ready_ = false;
+
+#ifdef AZMQ_ENABLE_OP_TRACING
+    // set by socket_service::enqueue, released before the handler is called
+    std::shared_ptr<op_trace> trace_;
+    uint64_t enqueued_at_ = 0;
+    uint64_t performed_at_ = 0;
+
+    bool do_perform(socket_type & socket) {
+        auto res = perform_func_(this, socket);
+        if (res && trace_)
+            performed_at_ = trace_->on_perform(enqueued_at_);
+        return res;
+    }
 
+    static void do_complete(reactor_op * op) {
+        if (op->trace_) {
+            if (op->performed_at_)
+                op->trace_->on_complete(op->performed_at_);
+            op->trace_.reset();
+        }
+        op->complete_func_(op, op->ec_, op->bytes_transferred_);
+    }
+#else
     bool do_perform(socket_type & socket) { return perform_func_(this, socket); }
     static void do_complete(reactor_op * op) {
         op->complete_func_(op, op->ec_, op->bytes_transferred_);
     }
+#endif
 
     static boost::system::error_code canceled() { return boost::asio::error::operation_aborted; }
 
@@ -49,6 +82,7 @@ protected:
     reactor_op(perform_func_type perform_func,
                complete_func_type complete_func)
         : bytes_transferred_(0)
+        , recycler_(nullptr)
         , perform_func_(perform_func)
         , complete_func_(complete_func)
     { }
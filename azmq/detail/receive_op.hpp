@@ -11,14 +11,17 @@
 
 #include "../error.hpp"
 #include "../message.hpp"
+#include "../message_pool.hpp"
 #include "socket_ops.hpp"
 #include "reactor_op.hpp"
+#include "handler_invoke.hpp"
 
 #include <boost/asio/io_service.hpp>
 
 #include <zmq.h>
 
 #include <iterator>
+#include <memory>
 
 namespace azmq {
 namespace detail {
@@ -58,8 +61,8 @@ template<typename MutableBufferSequence,
 class receive_buffer_op : public receive_buffer_op_base<MutableBufferSequence> {
 public:
     receive_buffer_op(MutableBufferSequence const& buffers,
-                      Handler handler,
-                      socket_ops::flags_type flags)
+                      socket_ops::flags_type flags,
+                      Handler handler)
         : receive_buffer_op_base<MutableBufferSequence>(buffers, flags,
                                                         &receive_buffer_op::do_complete)
         , handler_(std::move(handler))
@@ -72,8 +75,8 @@ public:
         auto h = std::move(o->handler_);
         auto ec = o->ec_;
         auto bt = o->bytes_transferred_;
-        delete o;
-        h(ec, bt);
+        destroy_op(o, h);
+        detail::invoke_handler(h, ec, bt);
     }
 
 private:
@@ -85,8 +88,8 @@ template<typename MutableBufferSequence,
 class receive_more_buffer_op : public receive_buffer_op_base<MutableBufferSequence> {
 public:
     receive_more_buffer_op(MutableBufferSequence const& buffers,
-                           Handler handler,
-                           socket_ops::flags_type flags)
+                           socket_ops::flags_type flags,
+                           Handler handler)
         : receive_buffer_op_base<MutableBufferSequence>(buffers, flags,
                                                         &receive_more_buffer_op::do_complete)
         , handler_(std::move(handler))
@@ -100,8 +103,173 @@ public:
         auto ec = o->ec_;
         auto bt = o->bytes_transferred_;
         auto m = o->more();
-        delete o;
-        h(ec, std::make_pair(bt, m));
+        destroy_op(o, h);
+        detail::invoke_handler(h, ec, std::make_pair(bt, m));
+    }
+
+private:
+    Handler handler_;
+};
+
+class receive_batch_op_base : public reactor_op {
+public:
+    receive_batch_op_base(size_t max_msgs,
+                          socket_ops::flags_type flags,
+                          complete_func_type complete_func)
+        : reactor_op(&receive_batch_op_base::do_perform, complete_func)
+        , max_msgs_(max_msgs)
+        , flags_(flags)
+    {
+        msgs_.reserve(max_msgs);
+    }
+
+    static bool do_perform(reactor_op* base, socket_type & socket) {
+        auto o = static_cast<receive_batch_op_base*>(base);
+        o->ec_ = boost::system::error_code();
+
+        o->bytes_transferred_ = socket_ops::receive_batch(o->msgs_, o->max_msgs_, socket,
+                                                          o->flags_ | ZMQ_DONTWAIT, o->ec_);
+        if (o->ec_)
+            return !o->try_again();
+        return true;
+    }
+
+protected:
+    message_vector msgs_;
+    size_t max_msgs_;
+    flags_type flags_;
+};
+
+template<typename Handler>
+class receive_batch_op : public receive_batch_op_base {
+public:
+    receive_batch_op(size_t max_msgs,
+                     socket_ops::flags_type flags,
+                     Handler handler)
+        : receive_batch_op_base(max_msgs, flags, &receive_batch_op::do_complete)
+        , handler_(std::move(handler))
+        { }
+
+    static void do_complete(reactor_op* base,
+                            const boost::system::error_code &,
+                            size_t) {
+        auto o = static_cast<receive_batch_op*>(base);
+        auto h = std::move(o->handler_);
+        auto v = std::move(o->msgs_);
+        auto ec = o->ec_;
+        auto bt = o->bytes_transferred_;
+        destroy_op(o, h);
+        detail::invoke_handler(h, ec, std::move(v), bt);
+    }
+
+private:
+    Handler handler_;
+};
+
+class receive_multipart_op_base : public reactor_op {
+public:
+    receive_multipart_op_base(multipart_buffer & buf,
+                              socket_ops::flags_type flags,
+                              complete_func_type complete_func)
+        : reactor_op(&receive_multipart_op_base::do_perform, complete_func)
+        , buf_(buf)
+        , flags_(flags)
+        { }
+
+    static bool do_perform(reactor_op* base, socket_type & socket) {
+        auto o = static_cast<receive_multipart_op_base*>(base);
+        o->ec_ = boost::system::error_code();
+
+        o->bytes_transferred_ = socket_ops::receive_multipart(o->buf_, socket,
+                                                              o->flags_ | ZMQ_DONTWAIT, o->ec_);
+        if (o->ec_)
+            return !o->try_again();
+        return true;
+    }
+
+private:
+    multipart_buffer & buf_;
+    flags_type flags_;
+};
+
+template<typename Handler>
+class receive_multipart_op : public receive_multipart_op_base {
+public:
+    receive_multipart_op(multipart_buffer & buf,
+                         socket_ops::flags_type flags,
+                         Handler handler)
+        : receive_multipart_op_base(buf, flags, &receive_multipart_op::do_complete)
+        , handler_(std::move(handler))
+        { }
+
+    static void do_complete(reactor_op* base,
+                            const boost::system::error_code &,
+                            size_t) {
+        auto o = static_cast<receive_multipart_op*>(base);
+        auto h = std::move(o->handler_);
+        auto ec = o->ec_;
+        auto bt = o->bytes_transferred_;
+        destroy_op(o, h);
+        detail::invoke_handler(h, ec, bt);
+    }
+
+private:
+    Handler handler_;
+};
+
+class receive_ring_op_base : public reactor_op {
+public:
+    receive_ring_op_base(frame_ring & ring,
+                         socket_ops::flags_type flags,
+                         complete_func_type complete_func)
+        : reactor_op(&receive_ring_op_base::do_perform, complete_func)
+        , ring_(ring)
+        , flags_(flags)
+    {
+        // a frame held over from the last receive may not be followed by any
+        // further readiness on the socket
+        ready_ = ring.has_pending();
+    }
+
+    static bool do_perform(reactor_op* base, socket_type & socket) {
+        auto o = static_cast<receive_ring_op_base*>(base);
+        o->ec_ = boost::system::error_code();
+
+        o->bytes_transferred_ = socket_ops::receive_ring(o->ring_, o->frames_, socket,
+                                                         o->flags_ | ZMQ_DONTWAIT, o->ec_);
+        if (o->ec_)
+            return !o->try_again();
+        return true;
+    }
+
+protected:
+    size_t frames_ = 0;
+
+private:
+    frame_ring & ring_;
+    flags_type flags_;
+};
+
+template<typename Handler>
+class receive_ring_op : public receive_ring_op_base {
+public:
+    receive_ring_op(frame_ring & ring,
+                    socket_ops::flags_type flags,
+                    Handler handler)
+        : receive_ring_op_base(ring, flags, &receive_ring_op::do_complete)
+        , handler_(std::move(handler))
+        { }
+
+    static void do_complete(reactor_op* base,
+                            const boost::system::error_code &,
+                            size_t) {
+        auto o = static_cast<receive_ring_op*>(base);
+        auto h = std::move(o->handler_);
+        auto ec = o->ec_;
+        auto frames = o->frames_;
+        auto bt = o->bytes_transferred_;
+        destroy_op(o, h);
+        detail::invoke_handler(h, ec, frames, bt);
     }
 
 private:
@@ -134,8 +302,8 @@ protected:
 template<typename Handler>
 class receive_op : public receive_op_base {
 public:
-    receive_op(Handler handler,
-               socket_ops::flags_type flags)
+    receive_op(socket_ops::flags_type flags,
+               Handler handler)
         : receive_op_base(flags, &receive_op::do_complete)
         , handler_(std::move(handler))
         { }
@@ -148,13 +316,179 @@ public:
         auto m = std::move(o->msg_);
         auto ec = o->ec_;
         auto bt = o->bytes_transferred_;
-        delete o;
-        h(ec, m, bt);
+        destroy_op(o, h);
+        detail::invoke_handler(h, ec, std::move(m), bt);
     }
 
 private:
     Handler handler_;
 };
+
+// pool refers to the socket's pool, which is only read, and created on first
+// use, here in do_perform under the socket's lock
+class receive_pooled_op_base : public reactor_op {
+public:
+    receive_pooled_op_base(std::shared_ptr<message_pool> * pool,
+                           socket_ops::flags_type flags,
+                           complete_func_type complete_func)
+        : reactor_op(&receive_pooled_op_base::do_perform, complete_func)
+        , pool_(pool)
+        , flags_(flags)
+        { }
+
+    static bool do_perform(reactor_op* base, socket_type & socket) {
+        auto o = static_cast<receive_pooled_op_base*>(base);
+        o->ec_ = boost::system::error_code();
+
+        // the lease is kept across EAGAIN, so at most one is taken per receive
+        if (!o->msg_) {
+            if (!*o->pool_)
+                *o->pool_ = message_pool::create();
+            o->msg_ = (*o->pool_)->lease();
+        }
+        o->bytes_transferred_ = socket_ops::receive(*o->msg_, socket, o->flags_ | ZMQ_DONTWAIT, o->ec_);
+        if (o->ec_)
+            return !o->try_again();
+        return true;
+    }
+
+protected:
+    std::shared_ptr<message_pool> * pool_;
+    pooled_message msg_;
+    flags_type flags_;
+};
+
+template<typename Handler>
+class receive_pooled_op : public receive_pooled_op_base {
+public:
+    receive_pooled_op(std::shared_ptr<message_pool> * pool,
+                      socket_ops::flags_type flags,
+                      Handler handler)
+        : receive_pooled_op_base(pool, flags, &receive_pooled_op::do_complete)
+        , handler_(std::move(handler))
+        { }
+
+    static void do_complete(reactor_op* base,
+                            const boost::system::error_code &,
+                            size_t) {
+        auto o = static_cast<receive_pooled_op*>(base);
+        auto h = std::move(o->handler_);
+        auto m = std::move(o->msg_);
+        auto ec = o->ec_;
+        auto bt = o->bytes_transferred_;
+        destroy_op(o, h);
+        detail::invoke_handler(h, ec, std::move(m), bt);
+    }
+
+private:
+    Handler handler_;
+};
+
+class receive_continuous_op_base : public reactor_op {
+public:
+    receive_continuous_op_base(size_t max_batch,
+                               socket_ops::flags_type flags,
+                               complete_func_type complete_func)
+        : reactor_op(&receive_continuous_op_base::do_perform, complete_func)
+        , msgs_(max_batch)
+        , received_(0)
+        , flags_(flags)
+    {
+        BOOST_ASSERT_MSG(max_batch, "max_batch must be non-zero");
+    }
+
+    // receives frames into the op's own message slots, reused from one
+    // perform to the next, until none remain or every slot is filled
+    static bool do_perform(reactor_op* base, socket_type & socket) {
+        auto o = static_cast<receive_continuous_op_base*>(base);
+        o->ec_ = boost::system::error_code();
+        o->received_ = 0;
+        o->bytes_transferred_ = 0;
+        while (o->received_ != o->msgs_.size()) {
+            boost::system::error_code ec;
+            auto sz = socket_ops::receive(o->msgs_[o->received_], socket, o->flags_ | ZMQ_DONTWAIT, ec);
+            if (ec) {
+                // running out of frames after the first is not an error
+                if (!o->received_ || ec.value() != boost::system::errc::resource_unavailable_try_again)
+                    o->ec_ = ec;
+                break;
+            }
+            o->bytes_transferred_ += sz;
+            ++o->received_;
+        }
+        if (o->ec_)
+            return !o->try_again();
+        return true;
+    }
+
+protected:
+    message_vector msgs_;
+    size_t received_;
+    flags_type flags_;
+};
+
+/** \brief standing receive, see socket::async_receive_continuous
+ *  \remark Not destroyed on completion: the handler is called for each
+ *  frame received and the op put back on the read queue through
+ *  Service::rearm(). It completes for good, and is destroyed, on error
+ *  or once cancelled, including by a cancel() issued while it was off
+ *  the queue delivering frames.
+ */
+template<typename Service, typename Handler>
+class receive_continuous_op : public receive_continuous_op_base {
+public:
+    using owner_type = std::weak_ptr<typename Service::per_descriptor_data>;
+
+    receive_continuous_op(Service & service,
+                          typename Service::implementation_type const& owner,
+                          size_t max_batch,
+                          socket_ops::flags_type flags,
+                          Handler handler)
+        : receive_continuous_op_base(max_batch, flags, &receive_continuous_op::do_complete)
+        , service_(service)
+        , owner_(owner)
+        , generation_(Service::cancel_generation(owner))
+        , handler_(std::move(handler))
+        { }
+
+    static void do_complete(reactor_op* base,
+                            const boost::system::error_code &,
+                            size_t) {
+        auto o = static_cast<receive_continuous_op*>(base);
+        detail::run_in_handler_context(o->handler_, [o] { deliver(o); });
+    }
+
+private:
+    Service & service_;
+    owner_type owner_;
+    uint64_t generation_;
+    Handler handler_;
+
+    static void deliver(receive_continuous_op * o) {
+        try {
+            for (size_t i = 0; i != o->received_; ++i) {
+                auto& m = o->msgs_[i];
+                o->handler_(boost::system::error_code(), m, m.size());
+            }
+        } catch (...) {
+            auto h = std::move(o->handler_);
+            destroy_op(o, h);
+            throw;
+        }
+        o->received_ = 0;
+
+        auto ec = o->ec_;
+        // once back on the queue the op may be performed by another thread
+        if (!ec && o->service_.rearm(o->owner_, o, o->generation_))
+            return;
+
+        if (!ec)
+            ec = reactor_op::canceled();
+        auto h = std::move(o->handler_);
+        destroy_op(o, h);
+        detail::invoke_handler(h, ec, message(), size_t(0));
+    }
+};
 } // namespace detail
 } // namespace azmq
 #endif // AZMQ_DETAIL_RECEIVE_OP_HPP_
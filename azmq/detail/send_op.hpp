@@ -12,11 +12,24 @@
 #include "../message.hpp"
 #include "socket_ops.hpp"
 #include "reactor_op.hpp"
+#include "handler_invoke.hpp"
+#include "handler_alloc.hpp"
+#include "config/mutex.hpp"
+#include "config/lock_guard.hpp"
 
+#include <boost/version.hpp>
+#include <boost/optional.hpp>
 #include <boost/asio/io_service.hpp>
+#include <boost/asio/strand.hpp>
+#if BOOST_VERSION >= 106600
+#   include <boost/asio/post.hpp>
+#endif
+#include <boost/system/system_error.hpp>
 
 #include <zmq.h>
+#include <atomic>
 #include <iterator>
+#include <memory>
 
 namespace azmq {
 namespace detail {
@@ -35,7 +48,13 @@ public:
     static bool do_perform(reactor_op* base, socket_type & socket) {
         auto o = static_cast<send_buffer_op_base*>(base);
         o->ec_ = boost::system::error_code();
-        o->bytes_transferred_ += socket_ops::send(o->buffers_, socket, o->flags_ | ZMQ_DONTWAIT, o->ec_);
+        try {
+            o->bytes_transferred_ += socket_ops::send(o->buffers_, socket, o->flags_ | ZMQ_DONTWAIT, o->ec_);
+        } catch (boost::system::system_error const& e) {
+            // failure to build a message part completes the op rather than
+            // unwinding through the reactor
+            o->ec_ = e.code();
+        }
         if (o->ec_) {
             return !o->try_again();
         }
@@ -43,7 +62,7 @@ public:
     }
 
 private:
-    ConstBufferSequence const& buffers_;
+    ConstBufferSequence buffers_;
     flags_type flags_;
 };
 
@@ -52,8 +71,8 @@ template<typename ConstBufferSequence,
 class send_buffer_op : public send_buffer_op_base<ConstBufferSequence> {
 public:
     send_buffer_op(ConstBufferSequence const& buffers,
-                   Handler handler,
-                   reactor_op::flags_type flags)
+                   reactor_op::flags_type flags,
+                   Handler handler)
         : send_buffer_op_base<ConstBufferSequence>(buffers, flags,
                                                    &send_buffer_op::do_complete)
         , handler_(std::move(handler))
@@ -66,9 +85,9 @@ public:
         auto h = std::move(o->handler_);
         auto ec = o->ec_;
         auto bt = o->bytes_transferred_;
-        delete o;
+        destroy_op(o, h);
 
-        h(ec, bt);
+        detail::invoke_handler(h, ec, bt);
     }
 
 private:
@@ -104,8 +123,8 @@ template<typename Handler>
 class send_op : public send_op_base {
 public:
     send_op(message msg,
-            Handler handler,
-            flags_type flags)
+            flags_type flags,
+            Handler handler)
         : send_op_base(std::move(msg), flags, &send_op::do_complete)
         , handler_(std::move(handler))
     { }
@@ -117,14 +136,180 @@ public:
         auto h = std::move(o->handler_);
         auto ec = o->ec_;
         auto bt = o->bytes_transferred_;
-        delete o;
-        h(ec, bt);
+        destroy_op(o, h);
+        detail::invoke_handler(h, ec, bt);
     }
 
 private:
     Handler handler_;
 };
 
+/** \brief set once the owning socket_service has been shut down
+ *  \remark Shared with ops which may complete after that, on one of libzmq's
+ *  I/O threads. Holding the lock while posting keeps shutdown from starting
+ *  part way through a post.
+ */
+class service_shutdown_flag {
+public:
+    template<typename Function>
+    bool unless_shut_down(Function && f) {
+        lock_guard_t<mutex_t> l{ mutex_ };
+        if (shut_down_)
+            return false;
+        f();
+        return true;
+    }
+
+    void set() {
+        lock_guard_t<mutex_t> l{ mutex_ };
+        shut_down_ = true;
+    }
+
+private:
+    mutex_t mutex_;
+    bool shut_down_ = false;
+};
+
+// Sends each buffer as a frame referencing the caller's memory. The op holds
+// one reference for itself and one per frame handed to libzmq, the handler
+// runs once libzmq has released the last of them. As that may be after the
+// io_service has gone, the op is allocated with plain new, see
+// outlives_service, and holds no work on the io_service.
+template<typename ConstBufferSequence,
+         typename Handler>
+class send_nocopy_op : public reactor_op {
+public:
+    using strand_type = boost::asio::io_service::strand;
+
+    send_nocopy_op(std::shared_ptr<service_shutdown_flag> const& shutdown,
+                   boost::asio::io_service & ios,
+                   strand_type const* strand,
+                   ConstBufferSequence const& buffers,
+                   flags_type flags,
+                   Handler handler)
+        : reactor_op(&send_nocopy_op::do_perform, &send_nocopy_op::do_complete)
+        , shutdown_(shutdown)
+        , ios_(ios)
+        , buffers_(buffers)
+        , flags_(flags)
+        , refs_(1)
+        , handler_(std::move(handler))
+    {
+        if (strand)
+            strand_.emplace(*strand);
+    }
+
+    static bool do_perform(reactor_op* base, socket_type & socket) {
+        auto o = static_cast<send_nocopy_op*>(base);
+        o->ec_ = boost::system::error_code();
+
+        auto last = std::distance(std::begin(o->buffers_), std::end(o->buffers_)) - 1;
+        auto index = 0u;
+        for (auto it = std::begin(o->buffers_); it != std::end(o->buffers_); ++it, ++index) {
+            auto f = index == last ? o->flags_
+                                   : o->flags_ | ZMQ_SNDMORE;
+            boost::asio::const_buffer buf(*it);
+            o->refs_.fetch_add(1, std::memory_order_relaxed);
+            try {
+                // a frame which is not sent is released as msg goes out of scope
+                message msg(nocopy,
+                            boost::asio::mutable_buffer(const_cast<void*>(boost::asio::buffer_cast<void const*>(buf)),
+                                                        boost::asio::buffer_size(buf)),
+                            o, &send_nocopy_op::release);
+                o->bytes_transferred_ += socket_ops::send(msg, socket, f | ZMQ_DONTWAIT, o->ec_);
+            } catch (boost::system::system_error const& e) {
+                // the frame was never created
+                o->refs_.fetch_sub(1, std::memory_order_relaxed);
+                o->ec_ = e.code();
+            }
+            if (o->ec_)
+                return !o->try_again();
+        }
+        return true;
+    }
+
+    static void do_complete(reactor_op* base,
+                            const boost::system::error_code &,
+                            size_t) {
+        auto o = static_cast<send_nocopy_op*>(base);
+        if (o->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            finish(o);
+    }
+
+private:
+#if BOOST_VERSION >= 106600
+    // owns the op until run, an io_service destroyed with it still queued
+    // destroys it unrun
+    struct deferred_finish {
+        send_nocopy_op * op_;
+
+        explicit deferred_finish(send_nocopy_op * op) : op_(op) { }
+        deferred_finish(deferred_finish && rhs) : op_(rhs.op_) { rhs.op_ = nullptr; }
+        ~deferred_finish() { delete op_; }
+
+        void operator()() {
+            auto o = op_;
+            op_ = nullptr;
+            finish(o);
+        }
+    };
+#else
+    // asio prior to 1.11 requires copyable handlers, ownership of the op passes
+    // to whichever copy is run, an io_service destroyed with it still queued
+    // leaks the op
+    struct deferred_finish {
+        send_nocopy_op * op_;
+
+        explicit deferred_finish(send_nocopy_op * op) : op_(op) { }
+
+        void operator()() const { finish(op_); }
+    };
+#endif
+
+    // zmq_free_fn, may be called from one of libzmq's I/O threads
+    static void release(void *, void * hint) {
+        auto o = static_cast<send_nocopy_op*>(hint);
+        if (o->refs_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        auto posted = o->shutdown_->unless_shut_down([o] {
+#if BOOST_VERSION >= 106600
+            if (o->strand_)
+                boost::asio::post(*o->strand_, deferred_finish{ o });
+            else
+                boost::asio::post(o->ios_, deferred_finish{ o });
+#else
+            if (o->strand_)
+                o->strand_->post(deferred_finish{ o });
+            else
+                o->ios_.post(deferred_finish{ o });
+#endif
+        });
+        // nowhere left to run the handler
+        if (!posted)
+            delete o;
+    }
+
+    static void finish(send_nocopy_op * o) {
+        auto h = std::move(o->handler_);
+        auto ec = o->ec_;
+        auto bt = o->bytes_transferred_;
+        delete o;
+        detail::invoke_handler(h, ec, bt);
+    }
+
+    std::shared_ptr<service_shutdown_flag> shutdown_;
+    boost::asio::io_service & ios_;
+    boost::optional<strand_type> strand_;
+    ConstBufferSequence buffers_;
+    flags_type flags_;
+    std::atomic<size_t> refs_;
+    Handler handler_;
+};
+
+template<typename ConstBufferSequence,
+         typename Handler>
+struct outlives_service<send_nocopy_op<ConstBufferSequence, Handler>> : std::true_type { };
+
 } // namespace detail
 } // namespace azmq
 #endif // AZMQ_DETAIL_SEND_OP_HPP_
@@ -0,0 +1,134 @@
+/*
+    Copyright (c) 2013-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of azmq
+
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef AZMQ_DETAIL_SOCKET_COUNTERS_HPP_
+#define AZMQ_DETAIL_SOCKET_COUNTERS_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <ios>
+#include <ostream>
+
+namespace azmq {
+namespace detail {
+    /** \brief snapshot of a socket's counters, or their total over many sockets */
+    struct socket_stats {
+        uint64_t frames_sent = 0;
+        uint64_t bytes_sent = 0;
+        uint64_t frames_received = 0;
+        uint64_t bytes_received = 0;
+        // sends and receives which failed with EAGAIN
+        uint64_t try_agains = 0;
+        // the subset of try_agains which were sends, refused at the high water mark
+        uint64_t hwm_blocked_sends = 0;
+        // async ops performed at initiation, and those queued for the reactor instead
+        uint64_t speculative_completions = 0;
+        uint64_t queued_ops = 0;
+        uint64_t reactor_wakeups = 0;
+        uint64_t missed_events_posts = 0;
+
+        socket_stats& operator+=(socket_stats const& rhs) {
+            frames_sent += rhs.frames_sent;
+            bytes_sent += rhs.bytes_sent;
+            frames_received += rhs.frames_received;
+            bytes_received += rhs.bytes_received;
+            try_agains += rhs.try_agains;
+            hwm_blocked_sends += rhs.hwm_blocked_sends;
+            speculative_completions += rhs.speculative_completions;
+            queued_ops += rhs.queued_ops;
+            reactor_wakeups += rhs.reactor_wakeups;
+            missed_events_posts += rhs.missed_events_posts;
+            return *this;
+        }
+
+        friend std::ostream& operator<<(std::ostream& stm, socket_stats const& that) {
+            return stm << "frames_sent=" << that.frames_sent
+                       << " bytes_sent=" << that.bytes_sent
+                       << " frames_received=" << that.frames_received
+                       << " bytes_received=" << that.bytes_received
+                       << " try_agains=" << that.try_agains
+                       << " hwm_blocked_sends=" << that.hwm_blocked_sends
+                       << " speculative_completions=" << that.speculative_completions
+                       << " queued_ops=" << that.queued_ops
+                       << " reactor_wakeups=" << that.reactor_wakeups
+                       << " missed_events_posts=" << that.missed_events_posts;
+        }
+    };
+
+    /** \brief counters maintained by a socket, readable from any thread
+     *  \remark Increments are relaxed atomic adds, as not every path which
+     *  counts holds the socket's lock, so counts are exact even when e.g. a
+     *  synchronous send and an async receive run on different threads.
+     *  Readers never take the socket's lock.
+     */
+    class socket_counters {
+    public:
+        void on_send(uint64_t bytes) {
+            add(frames_sent_, 1);
+            add(bytes_sent_, bytes);
+        }
+
+        void on_receive(uint64_t bytes) {
+            add(frames_received_, 1);
+            add(bytes_received_, bytes);
+        }
+
+        void on_try_again(bool sending) {
+            add(try_agains_, 1);
+            if (sending)
+                add(hwm_blocked_sends_, 1);
+        }
+
+        void on_enqueue(bool speculative) { add(speculative ? speculative_completions_ : queued_ops_, 1); }
+        void on_reactor_wakeup() { add(reactor_wakeups_, 1); }
+        void on_missed_events_post() { add(missed_events_posts_, 1); }
+
+        socket_stats snapshot() const {
+            socket_stats res;
+            res.frames_sent = load(frames_sent_);
+            res.bytes_sent = load(bytes_sent_);
+            res.frames_received = load(frames_received_);
+            res.bytes_received = load(bytes_received_);
+            res.try_agains = load(try_agains_);
+            res.hwm_blocked_sends = load(hwm_blocked_sends_);
+            res.speculative_completions = load(speculative_completions_);
+            res.queued_ops = load(queued_ops_);
+            res.reactor_wakeups = load(reactor_wakeups_);
+            res.missed_events_posts = load(missed_events_posts_);
+            return res;
+        }
+
+    private:
+        using counter = std::atomic<uint64_t>;
+
+        static void add(counter & c, uint64_t n) {
+            c.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        static uint64_t load(counter const& c) { return c.load(std::memory_order_relaxed); }
+
+        counter frames_sent_{ 0 };
+        counter bytes_sent_{ 0 };
+        counter frames_received_{ 0 };
+        counter bytes_received_{ 0 };
+        counter try_agains_{ 0 };
+        counter hwm_blocked_sends_{ 0 };
+        counter speculative_completions_{ 0 };
+        counter queued_ops_{ 0 };
+        counter reactor_wakeups_{ 0 };
+        counter missed_events_posts_{ 0 };
+    };
+
+    // std::ios_base::iword slot of the show_stats manipulator
+    inline int show_stats_index() {
+        static const int index = std::ios_base::xalloc();
+        return index;
+    }
+} // namespace detail
+} // namespace azmq
+#endif // AZMQ_DETAIL_SOCKET_COUNTERS_HPP_
@@ -11,7 +11,10 @@
 
 #include "../error.hpp"
 #include "../message.hpp"
+#include "../multipart_buffer.hpp"
+#include "../frame_ring.hpp"
 #include "context_ops.hpp"
+#include "socket_counters.hpp"
 
 #include <boost/assert.hpp>
 #include <boost/format.hpp>
@@ -44,6 +47,10 @@ namespace detail {
         using endpoint_type = std::string;
 
         struct socket_close {
+            // counters of the owning socket, if any, maintained by send() and
+            // receive() below, which only ever see the socket_type
+            socket_counters * counters = nullptr;
+
             void operator()(void* socket) {
                 int v = 0;
                 auto rc = zmq_setsockopt(socket, ZMQ_LINGER, &v, sizeof(int));
@@ -89,17 +96,23 @@ namespace detail {
             return socket_type(res);
         }
 
-        static stream_descriptor get_stream_descriptor(boost::asio::io_service & io_service,
-                                                       socket_type & socket,
-                                                       boost::system::error_code & ec) {
+        static native_handle_type get_native_handle(socket_type & socket,
+                                                    boost::system::error_code & ec) {
             BOOST_ASSERT_MSG(socket, "invalid socket");
             native_handle_type handle = 0;
             auto size = sizeof(native_handle_type);
-            stream_descriptor res;
             auto rc = zmq_getsockopt(socket.get(), ZMQ_FD, &handle, &size);
             if (rc < 0)
                 ec = make_error_code();
-            else {
+            return handle;
+        }
+
+        static stream_descriptor get_stream_descriptor(boost::asio::io_service & io_service,
+                                                       socket_type & socket,
+                                                       boost::system::error_code & ec) {
+            stream_descriptor res;
+            auto handle = get_native_handle(socket, ec);
+            if (!ec) {
 #if ! defined BOOST_ASIO_WINDOWS
                 res.reset(new boost::asio::posix::stream_descriptor(io_service, handle));
 #else
@@ -258,11 +271,25 @@ namespace detail {
                            flags_type flags,
                            boost::system::error_code & ec) {
             BOOST_ASSERT_MSG(socket, "Invalid socket");
-            auto rc = zmq_msg_send(const_cast<zmq_msg_t*>(&msg.msg_), socket.get(), flags);
-            if (rc < 0) {
+            zmq_msg_t tmp;
+            auto pm = msg.native_for_send(tmp);
+            if (!pm) {
                 ec = make_error_code();
                 return 0;
             }
+            auto rc = zmq_msg_send(pm, socket.get(), flags);
+            if (rc < 0)
+                ec = make_error_code();
+            if (pm == &tmp)
+                zmq_msg_close(&tmp);
+            auto counters = socket.get_deleter().counters;
+            if (rc < 0) {
+                if (counters && ec.value() == boost::system::errc::resource_unavailable_try_again)
+                    counters->on_try_again(true);
+                return 0;
+            }
+            if (counters)
+                counters->on_send(rc);
             return rc;
         }
 
@@ -290,11 +317,16 @@ namespace detail {
                               flags_type flags,
                               boost::system::error_code & ec) {
             BOOST_ASSERT_MSG(socket, "Invalid socket");
-            auto rc = zmq_msg_recv(const_cast<zmq_msg_t*>(&msg.msg_), socket.get(), flags);
+            auto rc = zmq_msg_recv(msg.native_for_receive(), socket.get(), flags);
+            auto counters = socket.get_deleter().counters;
             if (rc < 0) {
                 ec = make_error_code();
+                if (counters && ec.value() == boost::system::errc::resource_unavailable_try_again)
+                    counters->on_try_again(false);
                 return 0;
             }
+            if (counters)
+                counters->on_receive(rc);
             return rc;
         }
 
@@ -346,6 +378,96 @@ namespace detail {
             return res;
         }
 
+        // parts beyond buf's capacity are left on the socket, and no_buffer_space reported
+        static size_t receive_multipart(multipart_buffer & buf,
+                                        socket_type & socket,
+                                        flags_type flags,
+                                        boost::system::error_code & ec) {
+            size_t res = 0;
+            buf.clear();
+            message * msg;
+            do {
+                msg = buf.next_slot();
+                if (!msg) {
+                    ec = make_error_code(boost::system::errc::no_buffer_space);
+                    return res;
+                }
+                auto sz = receive(*msg, socket, flags, ec);
+                if (ec) {
+                    buf.clear();
+                    return 0;
+                }
+                res += sz;
+                flags |= ZMQ_RCVMORE;
+            } while (msg->more());
+            return res;
+        }
+
+        // receives frames into ring until none remain or it is full, only the first
+        // receive honours flags, later ones never block. A frame which does not fit
+        // is kept by the ring and written first next time.
+        static size_t receive_ring(frame_ring & ring,
+                                   size_t & frames,
+                                   socket_type & socket,
+                                   flags_type flags,
+                                   boost::system::error_code & ec) {
+            size_t res = 0;
+            frames = 0;
+            for (;;) {
+                if (!ring.has_pending_) {
+                    boost::system::error_code ecc;
+                    receive(ring.pending_, socket, flags, ecc);
+                    if (ecc) {
+                        // running out of frames after the first is not an error
+                        if (!frames || ecc.value() != boost::system::errc::resource_unavailable_try_again)
+                            ec = ecc;
+                        break;
+                    }
+                    ring.has_pending_ = true;
+                    flags |= ZMQ_DONTWAIT;
+                }
+
+                auto sz = ring.pending_.size();
+                if (sz > ring.max_frame_size()) {
+                    // can never fit, discard it as a buffer receive would
+                    ring.has_pending_ = false;
+                    ec = make_error_code(boost::system::errc::no_buffer_space);
+                    break;
+                }
+
+                if (!ring.push(ring.pending_.cbuffer(), ring.pending_.more())) {
+                    if (!frames)
+                        ec = make_error_code(boost::system::errc::no_buffer_space);
+                    break;
+                }
+                ring.has_pending_ = false;
+                res += sz;
+                ++frames;
+            }
+            return res;
+        }
+
+        static size_t receive_batch(message_vector & vec,
+                                    size_t max_msgs,
+                                    socket_type & socket,
+                                    flags_type flags,
+                                    boost::system::error_code & ec) {
+            BOOST_ASSERT_MSG(max_msgs, "max_msgs must be non-zero");
+            size_t res = 0;
+            for (size_t n = 0; n != max_msgs; ++n) {
+                boost::system::error_code ecc;
+                auto sz = receive_more(vec, socket, flags, ecc);
+                if (ecc) {
+                    // running out of messages after the first is not an error
+                    if (!n || ecc.value() != boost::system::errc::resource_unavailable_try_again)
+                        ec = ecc;
+                    break;
+                }
+                res += sz;
+            }
+            return res;
+        }
+
         static size_t flush(socket_type & socket,
                             boost::system::error_code & ec) {
             size_t res = 0;
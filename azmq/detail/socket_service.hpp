@@ -10,6 +10,7 @@
 #define AZMQ_DETAIL_SOCKET_SERVICE_HPP__
 #include "../error.hpp"
 #include "../message.hpp"
+#include "../message_pool.hpp"
 #include "../option.hpp"
 #include "../util/scope_guard.hpp"
 #include "config/mutex.hpp"
@@ -20,9 +21,11 @@
 #include "context_ops.hpp"
 #include "socket_ops.hpp"
 #include "socket_ext.hpp"
+#include "socket_counters.hpp"
 #include "reactor_op.hpp"
 #include "send_op.hpp"
 #include "receive_op.hpp"
+#include "epoll_reactor.hpp"
 
 #include <boost/version.hpp>
 #include <boost/assert.hpp>
@@ -31,15 +34,19 @@
 #include <boost/system/system_error.hpp>
 #include <boost/container/flat_map.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/asio/strand.hpp>
 
 #if BOOST_VERSION < 10700
 #   define AZMQ_DETAIL_USE_IO_SERVICE 1
 #else
 #   include <boost/asio/post.hpp>
+#   include <boost/asio/bind_executor.hpp>
 #endif
 
+#include <atomic>
 #include <memory>
 #include <typeindex>
+#include <unordered_map>
 #include <string>
 #include <vector>
 #include <tuple>
@@ -64,7 +71,14 @@ namespace detail {
                                         &reactor_op::member_hook_
                                     >>;
         using exts_type = boost::container::flat_map<std::type_index, socket_ext>;
+        using strand_type = boost::asio::io_service::strand;
         using allow_speculative = opt::boolean<static_cast<int>(opt::limits::lib_socket_min)>;
+        using speculative_window = opt::integer<static_cast<int>(opt::limits::lib_socket_min) + 1>;
+        using events_query_count = opt::ulong_integer<static_cast<int>(opt::limits::lib_socket_min) + 2>;
+#ifdef AZMQ_ENABLE_OP_TRACING
+        using op_trace_stats = opt::base<op_trace::stats, static_cast<int>(opt::limits::lib_socket_min) + 3>;
+#endif
+        using use_epoll_reactor = opt::boolean<static_cast<int>(opt::limits::lib_ctx_min)>;
 
         enum class shutdown_type {
             none = 0,
@@ -80,13 +94,32 @@ namespace detail {
 
         struct per_descriptor_data {
             bool optimize_single_threaded_ = false;
+            boost::optional<strand_type> strand_;
+            boost::asio::io_service * ios_ = nullptr;
             socket_type socket_;
             stream_descriptor sd_;
+#ifdef AZMQ_DETAIL_HAS_EPOLL_REACTOR
+            // declared after socket_, the descriptor must leave epoll before the socket closes
+            epoll_reactor::registration epoll_registration_;
+#endif
             mutable boost::mutex mutex_;
-            bool in_speculative_completion_ = false;
+#ifndef NDEBUG
+            mutable std::atomic<bool> in_use_{ false };
+#endif
+            int speculative_in_flight_ = 0;
+            int speculative_window_ = 1;
             bool scheduled_ = false;
             bool missed_events_found_ = false;
             bool allow_speculative_ = true;
+            uint64_t events_queries_ = 0;
+            socket_counters counters_;
+            // bumped by each cancel_ops(), so ops off the queue at the time,
+            // such as a standing receive delivering frames, see they were cancelled
+            std::atomic<uint64_t> cancel_generation_{ 0 };
+#ifdef AZMQ_ENABLE_OP_TRACING
+            std::shared_ptr<op_trace> trace_ = std::make_shared<op_trace>();
+#endif
+            std::shared_ptr<message_pool> message_pool_;
             shutdown_type shutdown_ = shutdown_type::none;
             exts_type exts_;
             endpoint_type endpoint_;
@@ -101,17 +134,32 @@ namespace detail {
                          context_type & ctx,
                          int type,
                          bool optimize_single_threaded,
+                         bool use_stream_descriptor,
                          boost::system::error_code & ec) {
                 BOOST_ASSERT_MSG(!socket_, "socket already open");
                 socket_ = socket_ops::create_socket(ctx, type, ec);
                 if (ec) return;
+                socket_.get_deleter().counters = &counters_;
 
-                sd_ = socket_ops::get_stream_descriptor(ios, socket_, ec);
-                if (ec) return;
+                ios_ = &ios;
+                if (use_stream_descriptor) {
+                    sd_ = socket_ops::get_stream_descriptor(ios, socket_, ec);
+                    if (ec) return;
+                }
 
                 optimize_single_threaded_ = optimize_single_threaded;
             }
 
+            // false when readiness is delivered by the service's epoll_reactor
+            bool has_stream_descriptor() const { return !!sd_; }
+
+            void set_scheduled(bool scheduled) {
+#ifdef AZMQ_DETAIL_HAS_EPOLL_REACTOR
+                epoll_registration_.set_active(scheduled);
+#endif
+                scheduled_ = scheduled;
+            }
+
             int events_mask() const
             {
                 static_assert(2 == max_ops, "2 == max_ops");
@@ -119,29 +167,46 @@ namespace detail {
                      | (!op_queue_[write_op].empty() ? ZMQ_POLLOUT : 0);
             }
 
-            bool perform_ops(op_queue_type & ops, boost::system::error_code& ec) {
-                const int filter[max_ops] = { ZMQ_POLLIN, ZMQ_POLLOUT };
-                while(int evs = socket_ops::get_events(socket_, ec)& events_mask()) {
-                    if (ec)
-                        break;
+            int get_events(boost::system::error_code & ec) {
+                ++events_queries_;
+                return socket_ops::get_events(socket_, ec);
+            }
 
+            // events is a ZMQ_EVENTS snapshot already taken by the caller, or -1. The
+            // socket is only queried again after an op has consumed or produced a frame.
+            bool perform_ops(op_queue_type & ops, boost::system::error_code& ec, int events = -1) {
+                const int filter[max_ops] = { ZMQ_POLLIN, ZMQ_POLLOUT };
+                auto evs = (events < 0 ? get_events(ec) : events) & events_mask();
+                while (evs && !ec) {
+                    auto progress = false;
                     for (size_t i = 0; i != max_ops; ++i) {
                         if ((evs & filter[i]) && op_queue_[i].front().do_perform(socket_)) {
                             op_queue_[i].pop_front_and_dispose([&ops](reactor_op * op) {
                                 ops.push_back(*op);
                             });
+                            progress = true;
                         }
                     }
+
+                    if (!progress || !events_mask())
+                        break;
+                    evs = get_events(ec) & events_mask();
                 }
 
                 return 0 != events_mask(); // true if more operations scheduled
             }
 
             boost::system::error_code cancel_stream_descriptor(boost::system::error_code & ec) {
+                if (!sd_) {
+                    // no reactor wait to abort, so nothing else will clear this
+                    set_scheduled(false);
+                    return ec;
+                }
                 return socket_ops::cancel_stream_descriptor(sd_, ec);
             }
 
             void cancel_ops(boost::system::error_code const& ec, op_queue_type & ops) {
+                cancel_generation_.fetch_add(1, std::memory_order_relaxed);
                 for (size_t i = 0; i != max_ops; ++i) {
                     while (!op_queue_[i].empty()) {
                         op_queue_[i].front().ec_ = ec;
@@ -176,11 +241,19 @@ namespace detail {
                 stm << "socket[" << kinds[kind] << "]{ ";
                 if (!endpoint_.empty())
                     stm << (serverish_ ? '@' : '>') << endpoint_ << ' ';
+                if (stm.iword(show_stats_index()))
+                    stm << counters_.snapshot() << ' ';
                 stm << "}";
             }
 
             void lock() const {
-                if (optimize_single_threaded_) return;
+                if (optimize_single_threaded_) {
+#ifndef NDEBUG
+                    auto in_use = in_use_.exchange(true, std::memory_order_acquire);
+                    BOOST_ASSERT_MSG(!in_use, "concurrent access to a single threaded or strand serialized socket");
+#endif
+                    return;
+                }
                 mutex_.lock();
             }
 
@@ -190,7 +263,12 @@ namespace detail {
             }
 
             void unlock() const {
-                if (optimize_single_threaded_) return;
+                if (optimize_single_threaded_) {
+#ifndef NDEBUG
+                    in_use_.store(false, std::memory_order_release);
+#endif
+                    return;
+                }
                 mutex_.unlock();
             }
         };
@@ -209,25 +287,35 @@ namespace detail {
         { }
 
         void shutdown_service() override {
+            shutdown_flag_->set();
+#ifdef AZMQ_DETAIL_HAS_EPOLL_REACTOR
+            epoll_.reset();
+#endif
             ctx_.reset();
         }
 
         context_type context() const { return ctx_; }
 
+        std::shared_ptr<service_shutdown_flag> const& shutdown_flag() const { return shutdown_flag_; }
+
         void construct(implementation_type & impl) {
             impl = std::make_shared<per_descriptor_data>();
         }
 
         void move_construct(implementation_type & impl,
-                            socket_service &,
+                            socket_service & other_service,
                             implementation_type & other) {
             impl = std::move(other);
+            transfer_descriptor(impl, other_service);
         }
 
         void move_assign(implementation_type & impl,
-                         socket_service &,
+                         socket_service & other_service,
                          implementation_type & other) {
+            if (impl)
+                descriptors_.retire_descriptor(impl);
             impl = std::move(other);
+            transfer_descriptor(impl, other_service);
         }
 
         boost::system::error_code do_open(implementation_type & impl,
@@ -235,17 +323,55 @@ namespace detail {
                                           bool optimize_single_threaded,
                                           boost::system::error_code & ec) {
             BOOST_ASSERT_MSG(impl, "impl");
+#ifdef AZMQ_DETAIL_HAS_EPOLL_REACTOR
+            auto epoll = use_epoll_ ? epoll_ : nullptr;
+#else
+            auto epoll = false;
+#endif
 #ifdef AZMQ_DETAIL_USE_IO_SERVICE
-            impl->do_open(get_io_service(), ctx_, type, optimize_single_threaded, ec);
+            impl->do_open(get_io_service(), ctx_, type, optimize_single_threaded, !epoll, ec);
 #else
-            impl->do_open(get_io_context(), ctx_, type, optimize_single_threaded, ec);
+            impl->do_open(get_io_context(), ctx_, type, optimize_single_threaded, !epoll, ec);
+#endif
+#ifdef AZMQ_DETAIL_HAS_EPOLL_REACTOR
+            if (!ec && epoll) {
+                auto handle = socket_ops::get_native_handle(impl->socket_, ec);
+                if (!ec)
+                    impl->epoll_registration_ = epoll->add(handle, impl, ec);
+            }
 #endif
             if (ec)
                 impl.reset();
+            else
+                descriptors_.register_descriptor(impl);
+            return ec;
+        }
+
+        boost::system::error_code do_open(implementation_type & impl,
+                                          int type,
+                                          strand_type const& strand,
+                                          boost::system::error_code & ec) {
+            // the strand serializes all access, so no mutex is required
+            if (!do_open(impl, type, true, ec))
+                impl->strand_.emplace(strand);
             return ec;
         }
 
+        static strand_type const* get_strand(implementation_type const& impl) {
+            return impl->strand_ ? impl->strand_.get_ptr() : nullptr;
+        }
+
+        static boost::asio::io_service & context_of(strand_type & strand) {
+#ifdef AZMQ_DETAIL_USE_IO_SERVICE
+            return strand.get_io_service();
+#else
+            return strand.context();
+#endif
+        }
+
         void destroy(implementation_type & impl) {
+            if (impl)
+                descriptors_.retire_descriptor(impl);
             impl.reset();
         }
 
@@ -291,12 +417,45 @@ namespace detail {
             return context_ops::set_option(ctx_, option, ec);
         }
 
+        boost::system::error_code set_option(use_epoll_reactor const& option,
+                                             boost::system::error_code & ec) {
+#ifdef AZMQ_DETAIL_HAS_EPOLL_REACTOR
+            // sockets already open keep whichever reactor they were opened with
+            if (option.value() && !epoll_) {
+#ifdef AZMQ_DETAIL_USE_IO_SERVICE
+                epoll_ = epoll_reactor::create(get_io_service(), &epoll_dispatch, ec);
+#else
+                epoll_ = epoll_reactor::create(get_io_context(), &epoll_dispatch, ec);
+#endif
+                if (ec)
+                    return ec;
+            }
+            use_epoll_ = option.value();
+            ec = boost::system::error_code();
+#else
+            ec = option.value() ? make_error_code(boost::system::errc::operation_not_supported)
+                                : boost::system::error_code();
+#endif
+            return ec;
+        }
+
         template<typename Option>
         boost::system::error_code get_option(Option & option,
                                              boost::system::error_code & ec) {
             return context_ops::get_option(ctx_, option, ec);
         }
 
+        boost::system::error_code get_option(use_epoll_reactor & option,
+                                             boost::system::error_code & ec) {
+#ifdef AZMQ_DETAIL_HAS_EPOLL_REACTOR
+            option = use_epoll_reactor(use_epoll_);
+#else
+            option = use_epoll_reactor(false);
+#endif
+            ec = boost::system::error_code();
+            return ec;
+        }
+
         template<typename Option>
         boost::system::error_code set_option(implementation_type & impl,
                                              Option const& option,
@@ -308,6 +467,22 @@ namespace detail {
                     impl->allow_speculative_ = option.data() ? *static_cast<bool const*>(option.data())
                                                              : false;
                 break;
+            case events_query_count::static_name::value :
+#ifdef AZMQ_ENABLE_OP_TRACING
+            case op_trace_stats::static_name::value :
+#endif
+                    // read only
+                    ec = make_error_code(boost::system::errc::invalid_argument);
+                break;
+            case speculative_window::static_name::value :
+                    if (!option.data() || option.size() < sizeof(int) ||
+                            *static_cast<int const*>(option.data()) < 1) {
+                        ec = make_error_code(boost::system::errc::invalid_argument);
+                    } else {
+                        ec = boost::system::error_code();
+                        impl->speculative_window_ = *static_cast<int const*>(option.data());
+                    }
+                break;
             default:
                 for (auto& ext : impl->exts_) {
                     if (ext.second.set_option(option, ec)) {
@@ -335,6 +510,32 @@ namespace detail {
                         *static_cast<bool*>(option.data()) = impl->allow_speculative_;
                     }
                 break;
+            case speculative_window::static_name::value :
+                    if (option.size() < sizeof(int)) {
+                        ec = make_error_code(boost::system::errc::invalid_argument);
+                    } else {
+                        ec = boost::system::error_code();
+                        *static_cast<int*>(option.data()) = impl->speculative_window_;
+                    }
+                break;
+            case events_query_count::static_name::value :
+                    if (option.size() < sizeof(uint64_t)) {
+                        ec = make_error_code(boost::system::errc::invalid_argument);
+                    } else {
+                        ec = boost::system::error_code();
+                        *static_cast<uint64_t*>(option.data()) = impl->events_queries_;
+                    }
+                break;
+#ifdef AZMQ_ENABLE_OP_TRACING
+            case op_trace_stats::static_name::value :
+                    if (option.size() < sizeof(op_trace::stats)) {
+                        ec = make_error_code(boost::system::errc::invalid_argument);
+                    } else {
+                        ec = boost::system::error_code();
+                        impl->trace_->snapshot(*static_cast<op_trace::stats*>(option.data()));
+                    }
+                break;
+#endif
             default:
                 for (auto& ext : impl->exts_) {
                     if (ext.second.get_option(option, ec)) {
@@ -467,6 +668,18 @@ namespace detail {
             return r;
         }
 
+        size_t receive_multipart(implementation_type & impl,
+                                 multipart_buffer & buf,
+                                 flags_type flags,
+                                 boost::system::error_code & ec) {
+            unique_lock l{ *impl };
+            if (is_shutdown(impl, op_type::read_op, ec))
+                return 0;
+            auto r = socket_ops::receive_multipart(buf, impl->socket_, flags, ec);
+            check_missed_events(impl);
+            return r;
+        }
+
         size_t flush(implementation_type & impl,
                      boost::system::error_code & ec) {
             unique_lock l{ *impl };
@@ -477,24 +690,88 @@ namespace detail {
             return r;
         }
 
-        using reactor_op_ptr = std::unique_ptr<reactor_op>;
-        template<typename T, typename... Args>
-        void enqueue(implementation_type & impl, op_type o, Args&&... args) {
-            reactor_op_ptr p{ new T(std::forward<Args>(args)...) };
+        template<typename T, typename Handler, typename... Args>
+        void enqueue(implementation_type & impl, op_type o, Handler && handler, Args&&... args) {
+            reactor_op* p = make_op<T>(recycler_, std::forward<Handler>(handler),
+                                          std::forward<Args>(args)...);
             boost::system::error_code ec = enqueue(impl, o, p);
             if (ec) {
                 BOOST_ASSERT_MSG(p, "op ptr");
                 p->ec_ = ec;
-                reactor_op::do_complete(p.release());
+                reactor_op::do_complete(p);
             }
         }
 
+        /** \brief initiation passed to initiate_async, enqueues an Op<Params..., Handler>
+         *  \remark Arguments which must be passed by reference are wrapped in
+         *  std::ref, as a token such as use_awaitable may copy them before
+         *  the initiation runs.
+         */
+        template<template<typename...> class Op, typename... Params>
+        struct initiate_enqueue {
+            socket_service & service_;
+            implementation_type & impl_;
+            op_type type_;
+
+            template<typename Handler, typename... Args>
+            void operator()(Handler && handler, Args&&... args) const {
+                using type = Op<Params..., typename std::decay<Handler>::type>;
+                service_.enqueue<type>(impl_, type_, std::forward<Handler>(handler), std::forward<Args>(args)...);
+            }
+        };
+
+        static uint64_t cancel_generation(implementation_type const& impl) {
+            return impl->cancel_generation_.load(std::memory_order_relaxed);
+        }
+
+        /** \brief put a standing read op back on the socket's queue
+         *  \remark Returns false, leaving op to be completed by the caller, if
+         *  the socket has gone, been shut down for receives, or had its ops
+         *  cancelled since generation was read.
+         */
+        bool rearm(std::weak_ptr<per_descriptor_data> const& owner,
+                   reactor_op * op, uint64_t generation) {
+            auto impl = owner.lock();
+            if (!impl)
+                return false;
+            return !enqueue(impl, op_type::read_op, op, &generation);
+        }
+
+        /** \brief the socket's counters, read without taking its lock */
+        static socket_stats stats(implementation_type const& impl) {
+            return impl ? impl->counters_.snapshot() : socket_stats();
+        }
+
+        /** \brief totals of the counters of every socket opened on this service,
+         *  including sockets since closed
+         */
+        socket_stats stats() const { return descriptors_.stats(); }
+
+        /** \brief the socket's message pool, as read by a receive_pooled_op
+         *  \remark Only to be dereferenced under the socket's lock
+         */
+        static std::shared_ptr<message_pool> * message_pool_slot(implementation_type & impl) {
+            return &impl->message_pool_;
+        }
+
+        std::shared_ptr<message_pool> get_message_pool(implementation_type & impl) {
+            unique_lock l{ *impl };
+            if (!impl->message_pool_)
+                impl->message_pool_ = message_pool::create();
+            return impl->message_pool_;
+        }
+
         boost::system::error_code cancel(implementation_type & impl,
                                          boost::system::error_code & ec) {
-            unique_lock l{ *impl };
-            descriptors_.unregister_descriptor(impl);
-            cancel_ops(impl);
-            return impl->cancel_stream_descriptor(ec);
+            op_queue_type ops;
+            {
+                unique_lock l{ *impl };
+                impl->cancel_ops(reactor_op::canceled(), ops);
+                impl->cancel_stream_descriptor(ec);
+            }
+            while (!ops.empty())
+                ops.pop_front_and_dispose(reactor_op::do_complete);
+            return ec;
         }
 
         std::string monitor(implementation_type & impl, int events,
@@ -510,6 +787,12 @@ namespace detail {
 
     private:
         context_type ctx_;
+        op_recycler recycler_;
+        std::shared_ptr<service_shutdown_flag> shutdown_flag_ = std::make_shared<service_shutdown_flag>();
+#ifdef AZMQ_DETAIL_HAS_EPOLL_REACTOR
+        bool use_epoll_ = false;
+        std::shared_ptr<epoll_reactor> epoll_;
+#endif
 
         bool is_shutdown(implementation_type & impl, op_type o, boost::system::error_code & ec) {
             if (is_shutdown(o, impl->shutdown_)) {
@@ -533,7 +816,41 @@ namespace detail {
 
         using weak_descriptor_ptr = std::weak_ptr<per_descriptor_data>;
 
-        static void handle_missed_events(weak_descriptor_ptr const& weak_impl, boost::system::error_code ec) {
+        // sockets opened on a strand have all internal completions run on that strand
+        template<typename Handler>
+        static void post(implementation_type const& impl, Handler && handler) {
+#ifdef AZMQ_DETAIL_USE_IO_SERVICE
+            if (impl->strand_)
+                impl->strand_->post(std::forward<Handler>(handler));
+            else
+                impl->ios_->post(std::forward<Handler>(handler));
+#else
+            if (impl->strand_)
+                boost::asio::post(*impl->strand_, std::forward<Handler>(handler));
+            else
+                boost::asio::post(impl->ios_->get_executor(), std::forward<Handler>(handler));
+#endif
+        }
+
+        template<typename Handler>
+        static void async_wait(implementation_type const& impl, Handler && handler) {
+            // the epoll_reactor watches the socket for its whole lifetime, no wait to arm
+            if (!impl->has_stream_descriptor())
+                return;
+
+            if (impl->strand_)
+#ifdef AZMQ_DETAIL_USE_IO_SERVICE
+                impl->sd_->async_read_some(boost::asio::null_buffers(),
+                                           impl->strand_->wrap(std::forward<Handler>(handler)));
+#else
+                impl->sd_->async_read_some(boost::asio::null_buffers(),
+                                           boost::asio::bind_executor(*impl->strand_, std::forward<Handler>(handler)));
+#endif
+            else
+                impl->sd_->async_read_some(boost::asio::null_buffers(), std::forward<Handler>(handler));
+        }
+
+        static void handle_missed_events(weak_descriptor_ptr const& weak_impl, boost::system::error_code ec, int events) {
             auto impl = weak_impl.lock();
             if (!impl)
                 return;
@@ -545,7 +862,7 @@ namespace detail {
                 impl->missed_events_found_ = false;
 
                 if (!ec)
-                    impl->perform_ops(ops, ec);
+                    impl->perform_ops(ops, ec, events);
                 if (ec)
                     impl->cancel_ops(ec, ops);
             }
@@ -553,26 +870,50 @@ namespace detail {
                 ops.pop_front_and_dispose(reactor_op::do_complete);
         }
 
+        // posted at most once at a time per socket (see missed_events_found_),
+        // with its storage drawn from the service's op_recycler
+        struct missed_events_handler {
+            weak_descriptor_ptr owner_;
+            boost::system::error_code ec_;
+            int events_;
+            op_recycler * recycler_;
+
+            void operator()() const { handle_missed_events(owner_, ec_, events_); }
+
+#ifdef AZMQ_DETAIL_USE_ASSOCIATED_ALLOCATOR
+            using allocator_type = recycling_allocator<void>;
+            allocator_type get_allocator() const { return allocator_type(*recycler_); }
+#else
+            friend void* asio_handler_allocate(std::size_t size, missed_events_handler * h) {
+                return h->recycler_->allocate(size);
+            }
+
+            friend void asio_handler_deallocate(void* p, std::size_t, missed_events_handler * h) {
+                h->recycler_->deallocate(p);
+            }
+#endif
+        };
+
         void check_missed_events(implementation_type & impl)
         {
-            if (!impl->scheduled_ || impl->missed_events_found_)
+            // nothing queued means nothing which could have been missed
+            if (!impl->scheduled_ || impl->missed_events_found_ || !impl->events_mask())
                 return;
 
             boost::system::error_code ec;
-            auto evs = socket_ops::get_events(impl->socket_, ec) & impl->events_mask();
+            auto evs = impl->get_events(ec);
 
-            if (evs || ec)
+            if ((evs & impl->events_mask()) || ec)
             {
                 impl->missed_events_found_ = true;
-                weak_descriptor_ptr weak_impl(impl);
-#ifdef AZMQ_DETAIL_USE_IO_SERVICE
-                impl->sd_->get_io_service().post([weak_impl, ec]() { handle_missed_events(weak_impl, ec); });
-#else
-		boost::asio::post(impl->sd_->get_executor(), [weak_impl, ec]() { handle_missed_events(weak_impl, ec); });
-#endif
+                impl->counters_.on_missed_events_post();
+                post(impl, missed_events_handler{ impl, ec, evs, &recycler_ });
             }
         }
 
+        // Every open socket is registered for its whole lifetime, so that any ops
+        // still pending when the service is torn down get cancelled. Registration
+        // happens on open/close only, never on the per message scheduling path.
         struct descriptor_map {
             ~descriptor_map() {
                 lock_type l{ mutex_ };
@@ -584,31 +925,54 @@ namespace detail {
 
             void register_descriptor(implementation_type & impl) {
                 lock_type l{ mutex_ };
-                auto handle = impl->sd_->native_handle();
-                map_.emplace(handle, impl);
+                map_.emplace(impl.get(), impl);
             }
 
             void unregister_descriptor(implementation_type & impl) {
                 lock_type l{ mutex_ };
-                auto handle = impl->sd_->native_handle();
-                map_.erase(handle);
+                map_.erase(impl.get());
+            }
+
+            // unregisters a socket which is going away, keeping its counts in the totals
+            void retire_descriptor(implementation_type & impl) {
+                lock_type l{ mutex_ };
+                if (map_.erase(impl.get()))
+                    retired_ += impl->counters_.snapshot();
+            }
+
+            socket_stats stats() const {
+                lock_type l{ mutex_ };
+                auto res = retired_;
+                for (auto&& descriptor : map_)
+                    if (auto impl = descriptor.second.lock())
+                        res += impl->counters_.snapshot();
+                return res;
             }
 
         private:
             mutable boost::mutex mutex_;
+            socket_stats retired_;
             using lock_type = boost::unique_lock<boost::mutex>;
-            using key_type = socket_ops::native_handle_type;
-            boost::container::flat_map<key_type, weak_descriptor_ptr> map_;
+            using key_type = per_descriptor_data const*;
+            std::unordered_map<key_type, weak_descriptor_ptr> map_;
         };
 
+        void transfer_descriptor(implementation_type & impl, socket_service & other_service) {
+            if (!impl || &other_service == this)
+                return;
+            other_service.descriptors_.unregister_descriptor(impl);
+            descriptors_.register_descriptor(impl);
+        }
+
         struct reactor_handler {
-            descriptor_map & descriptors_;
             weak_descriptor_ptr per_descriptor_data_;
+            int events_;
 
-            reactor_handler(descriptor_map & descriptors,
-                            implementation_type const& per_descriptor_data)
-                : descriptors_(descriptors)
-                , per_descriptor_data_(per_descriptor_data)
+            // events is a ZMQ_EVENTS snapshot for the dispatch, -1 if none was taken
+            explicit reactor_handler(implementation_type const& per_descriptor_data,
+                                     int events = -1)
+                : per_descriptor_data_(per_descriptor_data)
+                , events_(events)
             { }
 
             void operator()(boost::system::error_code ec, size_t) const {
@@ -619,58 +983,61 @@ namespace detail {
                 op_queue_type ops;
                 {
                     unique_lock l{ *p };
+                    p->counters_.on_reactor_wakeup();
 
                     if (!ec)
-                        p->scheduled_ = p->perform_ops(ops, ec);
+                        p->set_scheduled(p->perform_ops(ops, ec, events_));
                     if (ec) {
-                        p->scheduled_ = false;
+                        p->set_scheduled(false);
                         p->cancel_ops(ec, ops);
                     }
 
                     if (p->scheduled_)
-                        p->sd_->async_read_some(boost::asio::null_buffers(), *this);
-                    else
-                        descriptors_.unregister_descriptor(p);
+                        async_wait(p, reactor_handler(p));
                 }
                 while (!ops.empty())
                     ops.pop_front_and_dispose(reactor_op::do_complete);
             }
 
-            static void schedule(descriptor_map & descriptors, implementation_type & impl) {
-                reactor_handler handler(descriptors, impl);
-                descriptors.register_descriptor(impl);
-
+            static void schedule(implementation_type & impl) {
                 boost::system::error_code ec;
-                auto evs = socket_ops::get_events(impl->socket_, ec) & impl->events_mask();
+                auto evs = impl->get_events(ec);
 
-                if (evs || ec) {
-#ifdef AZMQ_DETAIL_USE_IO_SERVICE
-  		    impl->sd_->get_io_service().post([handler, ec] { handler(ec, 0); });
-#else
-		    boost::asio::post(impl->sd_->get_executor(), [handler, ec] { handler(ec, 0); });
-#endif
+                if ((evs & impl->events_mask()) || ec) {
+                    reactor_handler handler(impl, evs);
+                    post(impl, [handler, ec] { handler(ec, 0); });
                 } else {
-                    impl->sd_->async_read_some(boost::asio::null_buffers(),
-                                                std::move(handler));
+                    async_wait(impl, reactor_handler(impl));
                 }
             }
         };
 
+#ifdef AZMQ_DETAIL_HAS_EPOLL_REACTOR
+        static void epoll_dispatch(std::shared_ptr<void> const& pv) {
+            auto impl = std::static_pointer_cast<per_descriptor_data>(pv);
+            reactor_handler handler(impl);
+            if (impl->strand_)
+                post(impl, [handler] { handler(boost::system::error_code(), 0); });
+            else
+                handler(boost::system::error_code(), 0);
+        }
+#endif
+
         struct deferred_completion {
             weak_descriptor_ptr owner_;
             reactor_op *op_;
 
             deferred_completion(implementation_type const& owner,
-                                reactor_op_ptr op)
+                                reactor_op * op)
                 : owner_(owner)
-                , op_(op.release())
+                , op_(op)
             { }
 
             void operator()() {
                 reactor_op::do_complete(op_);
                 if (auto p = owner_.lock()) {
                     unique_lock l{ *p };
-                    p->in_speculative_completion_ = false;
+                    --p->speculative_in_flight_;
                 }
             }
 
@@ -681,33 +1048,45 @@ namespace detail {
         descriptor_map descriptors_;
 
         boost::system::error_code enqueue(implementation_type & impl,
-                                        op_type o, reactor_op_ptr & op) {
+                                        op_type o, reactor_op *& op,
+                                        uint64_t const* generation = nullptr) {
             unique_lock l{ *impl };
             boost::system::error_code ec;
             if (is_shutdown(impl, o, ec))
                 return ec;
+            if (generation && *generation != impl->cancel_generation_.load(std::memory_order_relaxed))
+                return reactor_op::canceled();
 
-            // we have at most one speculative completion in flight at any time
-            if (impl->allow_speculative_ && !impl->in_speculative_completion_) {
+#ifdef AZMQ_ENABLE_OP_TRACING
+            op->trace_ = impl->trace_;
+            op->enqueued_at_ = op_trace::now();
+#endif
+            // we have at most speculative_window_ speculative completions in flight at any time
+            if (op->ready_ ||
+                    (impl->allow_speculative_ && impl->speculative_in_flight_ < impl->speculative_window_)) {
                 // attempt to execute speculatively when the op_queue is empty
                 if (impl->op_queue_[o].empty()) {
-                    if (op->do_perform(impl->socket_)) {
-                        impl->in_speculative_completion_ = true;
-                        l.unlock();
-#ifdef AZMQ_DETAIL_USE_IO_SERVICE			
-                        get_io_service().post(deferred_completion(impl, std::move(op)));
-#else
-                        get_io_context().post(deferred_completion(impl, std::move(op)));
+                    auto performed = op->do_perform(impl->socket_);
+#ifdef AZMQ_ENABLE_OP_TRACING
+                    impl->trace_->on_speculative(performed);
 #endif
+                    if (performed) {
+                        impl->counters_.on_enqueue(true);
+                        ++impl->speculative_in_flight_;
+                        l.unlock();
+                        post(impl, deferred_completion(impl, op));
+                        op = nullptr;
                         return ec;
                     }
                 }
             }
-            impl->op_queue_[o].push_back(*op.release());
+            impl->op_queue_[o].push_back(*op);
+            impl->counters_.on_enqueue(false);
+            op = nullptr;
 
             if (!impl->scheduled_) {
-                impl->scheduled_ = true;
-                reactor_handler::schedule(descriptors_, impl);
+                impl->set_scheduled(true);
+                reactor_handler::schedule(impl);
             } else {
                 check_missed_events(impl);
             }
@@ -0,0 +1,196 @@
+/*
+    Copyright (c) 2013-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of azmq
+
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef AZMQ_FRAME_RING_HPP_
+#define AZMQ_FRAME_RING_HPP_
+
+#include "message.hpp"
+
+#include <boost/assert.hpp>
+#include <boost/asio/buffer.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace azmq {
+namespace detail {
+    struct socket_ops;
+}
+
+AZMQ_V1_INLINE_NAMESPACE_BEGIN
+
+    /** \brief circular buffer of length prefixed frames over a caller supplied region
+     *  \remark Each frame is stored contiguously, preceded by an 8 byte header
+     *  holding its size and whether more parts follow, and padded to 8 bytes.
+     *  A frame which does not fit before the end of the region starts again at
+     *  its beginning, so frames are never split. Filled by push() or
+     *  async_receive_ring(), consumed in arrival order with front()/pop_front()
+     *  or consume().
+     *
+     *  Not thread safe, the region must outlive the frame_ring.
+     */
+    class frame_ring {
+    public:
+        explicit frame_ring(boost::asio::mutable_buffer region)
+            : data_(boost::asio::buffer_cast<unsigned char*>(region))
+            , capacity_(boost::asio::buffer_size(region) & ~size_t(alignment - 1))
+        {
+            BOOST_ASSERT_MSG(capacity_ > header_size, "region too small");
+        }
+
+        frame_ring(frame_ring const&) = delete;
+        frame_ring& operator=(frame_ring const&) = delete;
+
+        size_t capacity() const { return capacity_; }
+        bool empty() const { return frames_ == 0; }
+
+        /** \brief number of frames held */
+        size_t frames() const { return frames_; }
+
+        /** \brief whether a received frame is held until there is room for it */
+        bool has_pending() const { return has_pending_; }
+
+        /** \brief largest frame the ring can ever hold
+         *  \remark A header stores the size in 32 bits, with the largest value
+         *  reserved as the wrap marker, which caps this for regions of 4GiB or more.
+         */
+        size_t max_frame_size() const {
+            return (std::min)(capacity_ - header_size, size_t(wrap_marker - 1));
+        }
+
+        /** \brief oldest frame */
+        boost::asio::const_buffer front() const {
+            BOOST_ASSERT_MSG(!empty(), "empty frame_ring");
+            auto h = read_header(head_);
+            return boost::asio::buffer(data_ + head_ + header_size, h.size);
+        }
+
+        /** \brief whether more parts of the same message follow the oldest frame */
+        bool front_more() const {
+            BOOST_ASSERT_MSG(!empty(), "empty frame_ring");
+            return read_header(head_).flags & flag_more;
+        }
+
+        /** \brief release the oldest frame */
+        void pop_front() {
+            BOOST_ASSERT_MSG(!empty(), "empty frame_ring");
+            head_ = skip_wrap(head_ + record_size(read_header(head_).size));
+            if (--frames_ == 0)
+                head_ = tail_ = 0;
+        }
+
+        /** \brief call f(const_buffer, bool more) for each frame in order, releasing it
+         *  \return number of frames consumed
+         */
+        template<typename Func>
+        size_t consume(Func && f) {
+            size_t res = 0;
+            for (; !empty(); ++res) {
+                f(front(), front_more());
+                pop_front();
+            }
+            return res;
+        }
+
+        /** \brief append a copy of frame
+         *  \return false, leaving the ring unchanged, if there is no room for it
+         */
+        bool push(boost::asio::const_buffer const& frame, bool more = false) {
+            auto size = boost::asio::buffer_size(frame);
+            auto pos = find_space(size);
+            if (pos == npos)
+                return false;
+            if (pos != tail_)
+                write_header(tail_, header{ wrap_marker, 0 });
+            write_header(pos, header{ static_cast<uint32_t>(size), more ? flag_more : 0u });
+            if (size)
+                std::memcpy(data_ + pos + header_size, boost::asio::buffer_cast<const void*>(frame), size);
+            tail_ = pos + record_size(size);
+            if (tail_ == capacity_)
+                tail_ = 0;
+            ++frames_;
+            return true;
+        }
+
+    private:
+        friend struct detail::socket_ops;
+
+        enum : size_t {
+            header_size = 8,
+            alignment = 8
+        };
+
+        enum : uint32_t {
+            wrap_marker = 0xffffffff,
+            flag_more = 1
+        };
+
+        struct header {
+            uint32_t size;
+            uint32_t flags;
+        };
+
+        static const size_t npos = static_cast<size_t>(-1);
+
+        static size_t record_size(size_t size) {
+            return (header_size + size + alignment - 1) & ~size_t(alignment - 1);
+        }
+
+        // where a frame of size bytes would be written, or npos. When not at
+        // tail_ the frame wraps to the start of the region. An empty ring always
+        // has head_ == tail_ == 0.
+        size_t find_space(size_t size) const {
+            if (size > max_frame_size())
+                return npos;
+            if (empty())
+                return 0;
+            auto rec = record_size(size);
+            if (tail_ > head_) {
+                if (rec <= capacity_ - tail_)
+                    return tail_;
+                return rec <= head_ ? 0 : npos;
+            }
+            if (tail_ < head_ && rec <= head_ - tail_)
+                return tail_;
+            return npos;
+        }
+
+        header read_header(size_t pos) const {
+            header h;
+            std::memcpy(&h, data_ + pos, sizeof(h));
+            return h;
+        }
+
+        void write_header(size_t pos, header h) {
+            std::memcpy(data_ + pos, &h, sizeof(h));
+        }
+
+        // position of the next frame at or after pos, records are whole multiples
+        // of alignment, so a wrap always leaves room for a marker
+        size_t skip_wrap(size_t pos) const {
+            if (pos == tail_)
+                return pos;
+            if (pos == capacity_ || read_header(pos).size == wrap_marker)
+                return 0;
+            return pos;
+        }
+
+        unsigned char * data_;
+        size_t capacity_;
+        size_t head_ = 0;
+        size_t tail_ = 0;
+        size_t frames_ = 0;
+
+        // a received frame which did not fit, written first on the next receive
+        message pending_;
+        bool has_pending_ = false;
+    };
+AZMQ_V1_INLINE_NAMESPACE_END
+} // namespace azmq
+#endif // AZMQ_FRAME_RING_HPP_
@@ -0,0 +1,253 @@
+/*
+    Copyright (c) 2013-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of azmq
+
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef AZMQ_MAPPED_FILE_HPP_
+#define AZMQ_MAPPED_FILE_HPP_
+
+// mapped_file is built on POSIX mmap, and only defined, along with
+// AZMQ_HAS_MAPPED_FILE, where that is available
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#   define AZMQ_HAS_MAPPED_FILE 1
+#endif
+
+#ifdef AZMQ_HAS_MAPPED_FILE
+#include "message.hpp"
+
+#include <boost/assert.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/system/system_error.hpp>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <string>
+#include <utility>
+
+namespace azmq {
+AZMQ_V1_INLINE_NAMESPACE_BEGIN
+
+    /** \brief reference counted memory mapping of a file region
+     *  \remark Copies share the same mapping, which is unmapped when the
+     *  last copy and the last message created by frame() or frames() have
+     *  gone away. Frames refer to the mapping directly through a plain
+     *  zmq_free_fn, so a file can be split into frames and sent without
+     *  reading it into user memory.
+     *
+     *  A mapping created by create() is writable and shared with the file,
+     *  boost::asio::buffer(buffer(offset, length)) may then be passed to
+     *  socket::receive() or async_receive() to have received frames copied
+     *  straight into the file. Frames of a read only mapping must not be
+     *  written through.
+     *
+     *  POSIX only, check AZMQ_HAS_MAPPED_FILE.
+     */
+    class mapped_file {
+    public:
+        static const size_t npos = static_cast<size_t>(-1);
+
+        mapped_file() BOOST_NOEXCEPT : mapping_(nullptr) { }
+
+        /** \brief map length bytes of the file at path, starting at offset, read only
+         *  \param path std::string const&
+         *  \param offset size_t, need not be page aligned
+         *  \param length size_t, npos for the rest of the file
+         *  \throw boost::system::system_error
+         */
+        explicit mapped_file(std::string const& path,
+                             size_t offset = 0,
+                             size_t length = npos)
+            : mapping_(nullptr)
+        {
+            auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                throw_errno();
+            struct stat st;
+            if (::fstat(fd, &st)) {
+                auto e = errno;
+                ::close(fd);
+                throw_errno(e);
+            }
+            size_t file_size = st.st_size;
+            if (offset > file_size) {
+                ::close(fd);
+                throw_errno(EINVAL);
+            }
+            length = std::min(length, file_size - offset);
+            auto e = map(fd, offset, length, false);
+            ::close(fd);
+            if (e)
+                throw_errno(e);
+        }
+
+        /** \brief create or truncate the file at path to size bytes and map it read/write
+         *  \throw boost::system::system_error
+         */
+        static mapped_file create(std::string const& path, size_t size) {
+            auto fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0)
+                throw_errno();
+            if (::ftruncate(fd, size)) {
+                auto e = errno;
+                ::close(fd);
+                throw_errno(e);
+            }
+            mapped_file res;
+            auto e = res.map(fd, 0, size, true);
+            ::close(fd);
+            if (e)
+                throw_errno(e);
+            return res;
+        }
+
+        mapped_file(mapped_file const& other) BOOST_NOEXCEPT
+            : mapping_(other.mapping_) {
+            if (mapping_)
+                mapping_->refs_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        mapped_file(mapped_file && other) BOOST_NOEXCEPT
+            : mapping_(other.mapping_) {
+            other.mapping_ = nullptr;
+        }
+
+        mapped_file& operator=(mapped_file const& rhs) BOOST_NOEXCEPT {
+            mapped_file(rhs).swap(*this);
+            return *this;
+        }
+
+        mapped_file& operator=(mapped_file && rhs) BOOST_NOEXCEPT {
+            mapped_file(std::move(rhs)).swap(*this);
+            return *this;
+        }
+
+        ~mapped_file() {
+            if (mapping_)
+                release(nullptr, mapping_);
+        }
+
+        void swap(mapped_file & other) BOOST_NOEXCEPT {
+            std::swap(mapping_, other.mapping_);
+        }
+
+        size_t size() const BOOST_NOEXCEPT { return mapping_ ? mapping_->size_ : 0; }
+        bool writable() const BOOST_NOEXCEPT { return mapping_ && mapping_->writable_; }
+
+        const void * data() const BOOST_NOEXCEPT { return mapping_ ? mapping_->data_ : nullptr; }
+
+        boost::asio::const_buffer cbuffer() const BOOST_NOEXCEPT {
+            return boost::asio::buffer(data(), size());
+        }
+
+        /** \brief writable region of a mapping created by create() */
+        boost::asio::mutable_buffer buffer(size_t offset = 0, size_t length = npos) const {
+            BOOST_ASSERT_MSG(writable(), "mapping is read only");
+            BOOST_ASSERT_MSG(offset <= size(), "offset out of range");
+            return boost::asio::buffer(mapping_->data_ + offset, std::min(length, size() - offset));
+        }
+
+        /** \brief message referring to length bytes of the mapping at offset, without copying */
+        message frame(size_t offset, size_t length) const {
+            BOOST_ASSERT_MSG(offset <= size() && length <= size() - offset, "frame out of range");
+            if (!length)
+                return message();
+            mapping_->refs_.fetch_add(1, std::memory_order_relaxed);
+            try {
+                return message(nocopy, boost::asio::buffer(mapping_->data_ + offset, length), mapping_, &release);
+            } catch (...) {
+                release(nullptr, mapping_);
+                throw;
+            }
+        }
+
+        /** \brief the whole mapping as consecutive frames of at most frame_size bytes */
+        message_vector frames(size_t frame_size) const {
+            BOOST_ASSERT_MSG(frame_size, "frame_size must be non-zero");
+            message_vector res;
+            res.reserve((size() + frame_size - 1) / frame_size);
+            for (size_t offset = 0; offset < size(); offset += frame_size)
+                res.push_back(frame(offset, std::min(frame_size, size() - offset)));
+            return res;
+        }
+
+        /** \brief write modified pages of a writable mapping back to the file
+         *  \throw boost::system::system_error
+         */
+        void flush() const {
+            if (mapping_ && mapping_->base_ && ::msync(mapping_->base_, mapping_->mapped_size_, MS_SYNC))
+                throw_errno();
+        }
+
+        /** \brief number of mapped_file copies and frames sharing the mapping */
+        size_t use_count() const BOOST_NOEXCEPT {
+            return mapping_ ? mapping_->refs_.load(std::memory_order_relaxed) : 0;
+        }
+
+    private:
+        struct mapping {
+            std::atomic<size_t> refs_;
+            void * base_;
+            size_t mapped_size_;
+            unsigned char * data_;
+            size_t size_;
+            bool writable_;
+        };
+
+        static void throw_errno(int e = errno) {
+            throw boost::system::system_error(boost::system::error_code(e, boost::system::system_category()));
+        }
+
+        // returns 0 or an errno value
+        int map(int fd, size_t offset, size_t length, bool writable) {
+            auto m = new mapping();
+            m->refs_.store(1, std::memory_order_relaxed);
+            m->base_ = nullptr;
+            m->mapped_size_ = 0;
+            m->data_ = nullptr;
+            m->size_ = length;
+            m->writable_ = writable;
+            if (length) {
+                // mmap offsets must be page aligned
+                size_t page = ::sysconf(_SC_PAGESIZE);
+                auto aligned = offset / page * page;
+                m->mapped_size_ = length + (offset - aligned);
+                auto p = ::mmap(nullptr, m->mapped_size_,
+                                writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                                MAP_SHARED, fd, aligned);
+                if (p == MAP_FAILED) {
+                    auto e = errno;
+                    delete m;
+                    return e;
+                }
+                m->base_ = p;
+                m->data_ = static_cast<unsigned char*>(p) + (offset - aligned);
+            }
+            mapping_ = m;
+            return 0;
+        }
+
+        static void release(void *, void * hint) {
+            auto m = static_cast<mapping*>(hint);
+            if (m->refs_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+            if (m->base_)
+                ::munmap(m->base_, m->mapped_size_);
+            delete m;
+        }
+
+        mapping * mapping_;
+    };
+AZMQ_V1_INLINE_NAMESPACE_END
+} // namespace azmq
+#endif // AZMQ_HAS_MAPPED_FILE
+#endif // AZMQ_MAPPED_FILE_HPP_
@@ -29,6 +29,7 @@
 #include <memory>
 #include <vector>
 #include <ostream>
+#include <cstdint>
 #include <cstring>
 
 
@@ -40,11 +41,14 @@ namespace detail {
 AZMQ_V1_INLINE_NAMESPACE_BEGIN
 
     struct nocopy_t {};
+    struct gather_t {};
 
 #ifdef BOOST_NO_CXX11_CONSTEXPR
     const nocopy_t nocopy = nocopy_t{};
+    const gather_t gather = gather_t{};
 #else
     constexpr nocopy_t nocopy = nocopy_t{};
+    constexpr gather_t gather = gather_t{};
 #endif
 
 
@@ -53,24 +57,44 @@ AZMQ_V1_INLINE_NAMESPACE_BEGIN
 
         using flags_type = int;
 
-        message() BOOST_NOEXCEPT {
-            auto rc = zmq_msg_init(&msg_);
-            BOOST_ASSERT_MSG(rc == 0, "zmq_msg_init return non-zero"); (void)rc;
-        }
+        /** \brief messages of up to max_inline_size bytes are held inline
+         *  \remark Their payload is stored in the message itself, so they are
+         *  constructed, copied, compared and destroyed without calling into
+         *  libzmq. A zmq_msg_t is only initialised when the message is handed
+         *  to libzmq, e.g. on send.
+         */
+        enum : size_t { max_inline_size = 32 };
+
+        message() BOOST_NOEXCEPT { }
 
         explicit message(size_t size) {
+            if (size <= max_inline_size) {
+                inline_size_ = static_cast<uint8_t>(size);
+                return;
+            }
             auto rc = zmq_msg_init_size(&msg_, size);
             if (rc)
                 throw boost::system::system_error(make_error_code());
+            is_inline_ = false;
         }
 
-        message(boost::asio::const_buffer const& buffer) {
+        message(boost::asio::const_buffer const& buffer)
+            : message(boost::asio::buffer_size(buffer))
+        {
             auto sz = boost::asio::buffer_size(buffer);
-            auto rc = zmq_msg_init_size(&msg_, sz);
-            if (rc)
-                throw boost::system::system_error(make_error_code());
-            boost::asio::buffer_copy(boost::asio::buffer(zmq_msg_data(&msg_), sz),
-                                     buffer);
+            if (sz)
+                std::memcpy(mutable_data(), boost::asio::buffer_cast<const void*>(buffer), sz);
+        }
+
+        /** \brief a single part holding the concatenation of buffers
+         *  \remark The message is sized once for the total and each buffer
+         *  copied straight into it.
+         */
+        template<typename ConstBufferSequence>
+        message(gather_t, ConstBufferSequence const& buffers)
+            : message(boost::asio::buffer_size(buffers))
+        {
+            boost::asio::buffer_copy(boost::asio::buffer(mutable_data(), size()), buffers);
         }
 
         message(nocopy_t, boost::asio::const_buffer const& buffer)
@@ -90,6 +114,7 @@ AZMQ_V1_INLINE_NAMESPACE_BEGIN
                                         deleter, hint);
             if (rc)
                 throw boost::system::system_error(make_error_code());
+            is_inline_ = false;
         }
 
         template<class Deleter, class Enabler =
@@ -98,21 +123,7 @@ AZMQ_V1_INLINE_NAMESPACE_BEGIN
         message(nocopy_t, boost::asio::mutable_buffer const& buffer, Deleter&& deleter)
         {
             using D = typename std::decay<Deleter>::type;
-
-            const auto call_deleter = [](void *buf, void *hint) {
-                std::unique_ptr<D> deleter(reinterpret_cast<D*>(hint));
-                BOOST_ASSERT_MSG(deleter, "!deleter");
-                (*deleter)(buf);
-            };
-
-            std::unique_ptr<D> d(new D(std::forward<Deleter>(deleter)));
-            auto rc = zmq_msg_init_data(&msg_,
-                                        boost::asio::buffer_cast<void*>(buffer),
-                                        boost::asio::buffer_size(buffer),
-                                        call_deleter, d.get());
-            if (rc)
-                throw boost::system::system_error(make_error_code());
-            d.release();
+            init_data(buffer, std::forward<Deleter>(deleter), deleter_fits_hint<D>());
         }
 
         message(nocopy_t, boost::asio::mutable_buffer const& buffer, free_fn* deleter)
@@ -130,6 +141,7 @@ AZMQ_V1_INLINE_NAMESPACE_BEGIN
                                         call_deleter, reinterpret_cast<void *>(deleter));
             if (rc)
                 throw boost::system::system_error(make_error_code());
+            is_inline_ = false;
         }
 
 #if BOOST_VERSION >= 105300
@@ -139,21 +151,35 @@ AZMQ_V1_INLINE_NAMESPACE_BEGIN
 #endif
 
         message(message && rhs) BOOST_NOEXCEPT
-            : msg_(rhs.msg_)
+            : inline_size_(rhs.inline_size_)
+            , is_inline_(rhs.is_inline_)
         {
-            auto rc = zmq_msg_init(&rhs.msg_);
-            BOOST_ASSERT_MSG(rc == 0, "zmq_msg_init return non-zero"); (void)rc;
+            std::memcpy(&msg_, &rhs.msg_, sizeof(msg_));
+            rhs.inline_size_ = 0;
+            rhs.is_inline_ = true;
         }
 
         message& operator=(message && rhs) BOOST_NOEXCEPT {
-            msg_ = rhs.msg_;
-            auto rc = zmq_msg_init(&rhs.msg_);
-            BOOST_ASSERT_MSG(rc == 0, "zmq_msg_init return non-zero"); (void)rc;
-
+            if (this == &rhs)
+                return *this;
+            close();
+            std::memcpy(&msg_, &rhs.msg_, sizeof(msg_));
+            inline_size_ = rhs.inline_size_;
+            is_inline_ = rhs.is_inline_;
+            rhs.inline_size_ = 0;
+            rhs.is_inline_ = true;
             return *this;
         }
 
-        message(message const& rhs) {
+        message(message const& rhs)
+            : inline_size_(rhs.inline_size_)
+            , is_inline_(rhs.is_inline_)
+        {
+            if (is_inline_) {
+                // a fixed size copy is cheaper than a variable one this small
+                std::memcpy(inline_data_, rhs.inline_data_, max_inline_size);
+                return;
+            }
             auto rc = zmq_msg_init(const_cast<zmq_msg_t*>(&msg_));
             BOOST_ASSERT_MSG(rc == 0, "zmq_msg_init return non-zero");
             rc = zmq_msg_copy(const_cast<zmq_msg_t*>(&msg_),
@@ -163,6 +189,19 @@ AZMQ_V1_INLINE_NAMESPACE_BEGIN
         }
 
         message& operator=(message const& rhs) {
+            if (this == &rhs)
+                return *this;
+            if (rhs.is_inline_) {
+                close();
+                std::memcpy(inline_data_, rhs.inline_data_, max_inline_size);
+                inline_size_ = rhs.inline_size_;
+                return *this;
+            }
+            if (is_inline_) {
+                auto rc = zmq_msg_init(&msg_);
+                BOOST_ASSERT_MSG(rc == 0, "zmq_msg_init return non-zero"); (void)rc;
+                is_inline_ = false;
+            }
             auto rc = zmq_msg_copy(const_cast<zmq_msg_t*>(&msg_),
                                    const_cast<zmq_msg_t*>(&rhs.msg_));
             if (rc)
@@ -216,55 +255,136 @@ AZMQ_V1_INLINE_NAMESPACE_BEGIN
         }
 
         const void *data() const BOOST_NOEXCEPT {
-            return zmq_msg_data(const_cast<zmq_msg_t*>(&msg_));
+            return const_cast<message*>(this)->mutable_data();
         }
 
         size_t size() const BOOST_NOEXCEPT {
+            if (is_inline_)
+                return inline_size_;
             return zmq_msg_size(const_cast<zmq_msg_t*>(&msg_));
         }
 
         bool more() const BOOST_NOEXCEPT {
+            if (is_inline_)
+                return false;
             return zmq_msg_more(const_cast<zmq_msg_t*>(&msg_)) ? true : false;
         }
 
     private:
         friend detail::socket_ops;
-        zmq_msg_t msg_;
+        union {
+            zmq_msg_t msg_;
+            // payload while is_inline_, msg_ is not initialised
+            unsigned char inline_data_[max_inline_size];
+        };
+        uint8_t inline_size_ = 0;
+        bool is_inline_ = true;
 
         void close() BOOST_NOEXCEPT {
-            auto rc = zmq_msg_close(&msg_);
-            BOOST_ASSERT_MSG(rc == 0, "zmq_msg_close return non-zero"); (void)rc;
+            if (!is_inline_) {
+                auto rc = zmq_msg_close(&msg_);
+                BOOST_ASSERT_MSG(rc == 0, "zmq_msg_close return non-zero"); (void)rc;
+            }
+            inline_size_ = 0;
+            is_inline_ = true;
         }
 
-        // note, this is a bit fragile, currently the last two bytes in a
-        // zmq_msg_t hold the type and flags fields
-        enum {
-            flags_offset = sizeof(zmq_msg_t) - 1,
-            type_offset = sizeof(zmq_msg_t) - 2
-        };
+        // deleters which fit in the hint pointer are stored there rather than on the heap
+        template<typename D>
+        using deleter_fits_hint = std::integral_constant<bool,
+            sizeof(D) <= sizeof(void*) && alignof(D) <= alignof(void*) &&
+            std::is_trivially_copyable<D>::value>;
+
+        template<typename Deleter>
+        void init_data(boost::asio::mutable_buffer const& buffer, Deleter&& deleter, std::true_type) {
+            using D = typename std::decay<Deleter>::type;
+            using storage_type = typename std::aligned_storage<sizeof(void*), alignof(void*)>::type;
+
+            const auto call_deleter = [](void *buf, void *hint) {
+                storage_type s;
+                std::memcpy(&s, &hint, sizeof(hint));
+                (*reinterpret_cast<D*>(&s))(buf);
+            };
 
-        uint8_t flags() const BOOST_NOEXCEPT {
-            auto pm = const_cast<zmq_msg_t*>(&msg_);
-            auto p = reinterpret_cast<uint8_t*>(pm);
-            return p[flags_offset];
+            D d(std::forward<Deleter>(deleter));
+            void * hint = nullptr;
+            std::memcpy(&hint, &d, sizeof(D));
+            auto rc = zmq_msg_init_data(&msg_,
+                                        boost::asio::buffer_cast<void*>(buffer),
+                                        boost::asio::buffer_size(buffer),
+                                        call_deleter, hint);
+            if (rc)
+                throw boost::system::system_error(make_error_code());
+            is_inline_ = false;
         }
 
-        uint8_t type() const BOOST_NOEXCEPT {
-            auto pm = const_cast<zmq_msg_t*>(&msg_);
-            auto p = reinterpret_cast<uint8_t*>(pm);
-            return p[type_offset];
+        template<typename Deleter>
+        void init_data(boost::asio::mutable_buffer const& buffer, Deleter&& deleter, std::false_type) {
+            using D = typename std::decay<Deleter>::type;
+
+            const auto call_deleter = [](void *buf, void *hint) {
+                std::unique_ptr<D> deleter(reinterpret_cast<D*>(hint));
+                BOOST_ASSERT_MSG(deleter, "!deleter");
+                (*deleter)(buf);
+            };
+
+            std::unique_ptr<D> d(new D(std::forward<Deleter>(deleter)));
+            auto rc = zmq_msg_init_data(&msg_,
+                                        boost::asio::buffer_cast<void*>(buffer),
+                                        boost::asio::buffer_size(buffer),
+                                        call_deleter, d.get());
+            if (rc)
+                throw boost::system::system_error(make_error_code());
+            is_inline_ = false;
+            d.release();
         }
 
-        // flags and type we care about from msg.hpp in zeromq lib
-        enum
-        {
-            flag_shared = 128,
-            type_cmsg = 104
-        };
+        void * mutable_data() BOOST_NOEXCEPT {
+            if (is_inline_)
+                return inline_data_;
+            return zmq_msg_data(&msg_);
+        }
+
+        // msg_ for sending or, for an inline payload, tmp initialised with a
+        // copy of it, leaving the message itself untouched. The caller closes
+        // tmp if it was used. Returns nullptr, with errno set, if tmp could
+        // not be initialised.
+        zmq_msg_t * native_for_send(zmq_msg_t & tmp) const {
+            if (!is_inline_)
+                return const_cast<zmq_msg_t*>(&msg_);
+            if (zmq_msg_init_size(&tmp, inline_size_))
+                return nullptr;
+            std::memcpy(zmq_msg_data(&tmp), inline_data_, inline_size_);
+            return &tmp;
+        }
+
+        // msg_ for receiving into, any inline payload is discarded
+        zmq_msg_t * native_for_receive() BOOST_NOEXCEPT {
+            if (is_inline_) {
+                auto rc = zmq_msg_init(&msg_);
+                BOOST_ASSERT_MSG(rc == 0, "zmq_msg_init return non-zero"); (void)rc;
+                is_inline_ = false;
+            }
+            return &msg_;
+        }
 
         bool is_shared() const BOOST_NOEXCEPT {
-            // TODO use shared message property if libzmq version >= 4.1
-            return (flags() & flag_shared) || type() == type_cmsg;
+            if (is_inline_)
+                return false;
+#if ZMQ_VERSION >= ZMQ_MAKE_VERSION(4, 1, 0)
+            return zmq_msg_get(const_cast<zmq_msg_t*>(&msg_), ZMQ_SHARED) == 1;
+#else
+            // older libzmq has no ZMQ_SHARED property, but the last two bytes of
+            // its zmq_msg_t hold the type and flags fields (see msg.hpp)
+            enum {
+                flags_offset = sizeof(zmq_msg_t) - 1,
+                type_offset = sizeof(zmq_msg_t) - 2,
+                flag_shared = 128,
+                type_cmsg = 104
+            };
+            auto p = reinterpret_cast<uint8_t const*>(&msg_);
+            return (p[flags_offset] & flag_shared) || p[type_offset] == type_cmsg;
+#endif
         }
 
         void deep_copy() {
@@ -0,0 +1,204 @@
+/*
+    Copyright (c) 2013-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of azmq
+
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef AZMQ_MESSAGE_ARENA_HPP_
+#define AZMQ_MESSAGE_ARENA_HPP_
+
+#include "message.hpp"
+
+#include <boost/assert.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace azmq {
+AZMQ_V1_INLINE_NAMESPACE_BEGIN
+
+    /** \brief bump allocator for message payloads
+     *  \remark Payloads are carved out of fixed size chunks, and each message
+     *  is created with a plain zmq_free_fn pointing back at its chunk, so the
+     *  arena allocates nothing per message. libzmq still mallocs a small
+     *  reference counted content block for each message given a free
+     *  function, so a message costs one malloc, as one allocated by libzmq
+     *  does, but not one sized for its payload. A chunk is reused once the
+     *  arena has moved on from it and libzmq has released every message in
+     *  it, which may happen on any thread.
+     *
+     *  Messages of up to message::max_inline_size bytes are held inline and
+     *  ones larger than the chunk size are allocated by libzmq as usual.
+     *
+     *  allocate() and reset() are not thread safe, use one arena per thread,
+     *  e.g. via local().
+     */
+    class message_arena {
+    public:
+        enum : size_t {
+            default_chunk_size = 64 * 1024,
+            alignment = 16
+        };
+
+        explicit message_arena(size_t chunk_size = default_chunk_size)
+            : pool_(std::make_shared<pool>(chunk_size))
+        { }
+
+        message_arena(message_arena const&) = delete;
+        message_arena& operator=(message_arena const&) = delete;
+
+        ~message_arena() { reset(); }
+
+        /** \brief the calling thread's arena */
+        static message_arena & local() {
+            static thread_local message_arena arena;
+            return arena;
+        }
+
+        size_t chunk_size() const { return pool_->chunk_size_; }
+
+        /** \brief a message of size uninitialised bytes */
+        message allocate(size_t size) {
+            if (size <= message::max_inline_size || size > chunk_size())
+                return message(size);
+
+            if (!current_ || chunk_size() - offset_ < size)
+                next_chunk();
+            message res(nocopy, boost::asio::buffer(current_->data() + offset_, size), current_, &release);
+            offset_ = std::min(chunk_size(), align(offset_ + size));
+            ++allocated_;
+            return res;
+        }
+
+        /** \brief a message holding a copy of buffer */
+        message allocate(boost::asio::const_buffer const& buffer) {
+            auto res = allocate(boost::asio::buffer_size(buffer));
+            boost::asio::buffer_copy(res.buffer(), buffer);
+            return res;
+        }
+
+        /** \brief stop allocating from the current chunk
+         *  \remark Call at the end of a request scope. The chunk is reused once
+         *  every message allocated from it has been released.
+         */
+        void reset() {
+            if (!current_)
+                return;
+            current_->retire(allocated_);
+            current_ = nullptr;
+            offset_ = 0;
+            allocated_ = 0;
+        }
+
+        /** \brief chunks obtained from the system so far, for diagnostics */
+        size_t chunks_created() const {
+            return pool_->created_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        struct pool;
+
+        static size_t align(size_t n) {
+            return (n + alignment - 1) & ~size_t(alignment - 1);
+        }
+
+        // header at the start of each chunk's allocation, followed by the payload area
+        struct chunk {
+            // biased by the arena while it allocates from the chunk, so that
+            // allocation need not touch the count
+            enum : size_t { bias = std::numeric_limits<size_t>::max() / 2 };
+
+            std::atomic<size_t> refs_;
+            std::shared_ptr<pool> pool_;
+
+            unsigned char * data() {
+                return reinterpret_cast<unsigned char*>(this) + align(sizeof(chunk));
+            }
+
+            void retire(size_t allocated) {
+                auto n = bias - allocated;
+                if (refs_.fetch_sub(n, std::memory_order_acq_rel) == n)
+                    recycle(this);
+            }
+        };
+
+        struct pool {
+            explicit pool(size_t chunk_size)
+                : chunk_size_(chunk_size)
+            {
+                BOOST_ASSERT_MSG(chunk_size > message::max_inline_size, "chunk_size too small");
+            }
+
+            ~pool() {
+                for (auto c : free_)
+                    destroy(c);
+            }
+
+            enum { max_free = 8 };
+
+            size_t chunk_size_;
+            std::atomic<size_t> created_{ 0 };
+            boost::mutex mutex_;
+            std::vector<chunk*> free_;
+        };
+
+        static void destroy(chunk * c) {
+            c->~chunk();
+            ::operator delete(c);
+        }
+
+        static void recycle(chunk * c) {
+            // the chunk may hold the last reference to its pool
+            auto p = std::move(c->pool_);
+            {
+                boost::unique_lock<boost::mutex> l{ p->mutex_ };
+                if (p->free_.size() < pool::max_free) {
+                    p->free_.push_back(c);
+                    return;
+                }
+            }
+            destroy(c);
+        }
+
+        static void release(void *, void * hint) {
+            auto c = static_cast<chunk*>(hint);
+            if (c->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                recycle(c);
+        }
+
+        void next_chunk() {
+            reset();
+            {
+                boost::unique_lock<boost::mutex> l{ pool_->mutex_ };
+                if (!pool_->free_.empty()) {
+                    current_ = pool_->free_.back();
+                    pool_->free_.pop_back();
+                }
+            }
+            if (!current_) {
+                auto pv = ::operator new(align(sizeof(chunk)) + chunk_size());
+                current_ = new (pv) chunk();
+                pool_->created_.fetch_add(1, std::memory_order_relaxed);
+            }
+            current_->refs_.store(chunk::bias, std::memory_order_relaxed);
+            current_->pool_ = pool_;
+        }
+
+        std::shared_ptr<pool> pool_;
+        chunk * current_ = nullptr;
+        size_t offset_ = 0;
+        size_t allocated_ = 0;
+    };
+AZMQ_V1_INLINE_NAMESPACE_END
+} // namespace azmq
+#endif // AZMQ_MESSAGE_ARENA_HPP_
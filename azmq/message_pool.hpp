@@ -0,0 +1,206 @@
+/*
+    Copyright (c) 2013-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of azmq
+
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef AZMQ_MESSAGE_POOL_HPP_
+#define AZMQ_MESSAGE_POOL_HPP_
+
+#include "message.hpp"
+
+#include <boost/assert.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#include <atomic>
+#include <memory>
+
+namespace azmq {
+AZMQ_V1_INLINE_NAMESPACE_BEGIN
+    class message_pool;
+
+    /** \brief reference counted lease of a message from a message_pool
+     *  \remark Copies share the same underlying message, which is returned to
+     *  its pool, with the frame data released, when the last copy goes away.
+     *  A received frame can thus be handed around and parsed in place without
+     *  copying it out of the message libzmq received it into.
+     */
+    class pooled_message {
+    public:
+        pooled_message() BOOST_NOEXCEPT : node_(nullptr) { }
+
+        pooled_message(pooled_message const& other) BOOST_NOEXCEPT
+            : node_(other.node_) {
+            if (node_)
+                node_->refs_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        pooled_message(pooled_message && other) BOOST_NOEXCEPT
+            : node_(other.node_) {
+            other.node_ = nullptr;
+        }
+
+        pooled_message& operator=(pooled_message const& rhs) BOOST_NOEXCEPT {
+            pooled_message(rhs).swap(*this);
+            return *this;
+        }
+
+        pooled_message& operator=(pooled_message && rhs) BOOST_NOEXCEPT {
+            pooled_message(std::move(rhs)).swap(*this);
+            return *this;
+        }
+
+        ~pooled_message() { reset(); }
+
+        void swap(pooled_message & other) BOOST_NOEXCEPT {
+            std::swap(node_, other.node_);
+        }
+
+        explicit operator bool() const BOOST_NOEXCEPT { return node_ != nullptr; }
+
+        message & operator*() const BOOST_NOEXCEPT {
+            BOOST_ASSERT_MSG(node_, "empty pooled_message");
+            return node_->msg_;
+        }
+
+        message * operator->() const BOOST_NOEXCEPT {
+            BOOST_ASSERT_MSG(node_, "empty pooled_message");
+            return &node_->msg_;
+        }
+
+        message * get() const BOOST_NOEXCEPT { return node_ ? &node_->msg_ : nullptr; }
+
+        boost::asio::const_buffer buffer() const BOOST_NOEXCEPT {
+            return node_ ? node_->msg_.cbuffer() : boost::asio::const_buffer();
+        }
+
+        size_t use_count() const BOOST_NOEXCEPT {
+            return node_ ? node_->refs_.load(std::memory_order_relaxed) : 0;
+        }
+
+        void reset();
+
+    private:
+        friend class message_pool;
+
+        struct node {
+            message msg_;
+            std::atomic<size_t> refs_;
+            node * next_;
+            message_pool * pool_;
+
+            explicit node(message_pool * pool) : refs_(0), next_(nullptr), pool_(pool) { }
+        };
+
+        explicit pooled_message(node * n) BOOST_NOEXCEPT
+            : node_(n)
+        { }
+
+        node * node_;
+    };
+
+    /** \brief free list of messages, leased out as pooled_message
+     *  \remark Thread safe, leases may be released from any thread. The
+     *  pool retains up to max_free idle messages, beyond that released
+     *  messages are freed. The pool outlives its last shared_ptr until every
+     *  lease has been released, leases count against a plain atomic rather
+     *  than each holding a shared_ptr to the pool.
+     */
+    class message_pool {
+    public:
+        static std::shared_ptr<message_pool> create(size_t max_free = 64) {
+            return std::shared_ptr<message_pool>(new message_pool(max_free),
+                                                 [](message_pool * p) { p->release(); });
+        }
+
+        message_pool(message_pool const&) = delete;
+        message_pool& operator=(message_pool const&) = delete;
+
+        /** \brief lease an empty message from the pool */
+        pooled_message lease() {
+            node * n = nullptr;
+            {
+                lock_type l{ mutex_ };
+                if (free_) {
+                    n = free_;
+                    free_ = n->next_;
+                    --free_ct_;
+                }
+            }
+            if (!n)
+                n = new node(this);
+            n->next_ = nullptr;
+            n->refs_.store(1, std::memory_order_relaxed);
+            refs_.fetch_add(1, std::memory_order_relaxed);
+            return pooled_message(n);
+        }
+
+        /** \brief number of idle messages held by the pool */
+        size_t free_count() const {
+            lock_type l{ mutex_ };
+            return free_ct_;
+        }
+
+    private:
+        friend class pooled_message;
+        using lock_type = boost::unique_lock<boost::mutex>;
+        using node = pooled_message::node;
+
+        explicit message_pool(size_t max_free)
+            : max_free_(max_free)
+        { }
+
+        ~message_pool() {
+            while (free_) {
+                auto n = free_;
+                free_ = n->next_;
+                delete n;
+            }
+        }
+
+        void recycle(node * n) {
+            // close any frame data now rather than when the node is reused
+            n->msg_ = message();
+            {
+                lock_type l{ mutex_ };
+                if (free_ct_ < max_free_) {
+                    n->next_ = free_;
+                    free_ = n;
+                    ++free_ct_;
+                    n = nullptr;
+                }
+            }
+            delete n;
+            release();
+        }
+
+        // drops the owners' reference, or that of a lease
+        void release() {
+            if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                delete this;
+        }
+
+        // one for all of the pool's shared_ptr owners, plus one per lease
+        std::atomic<size_t> refs_{ 1 };
+        mutable boost::mutex mutex_;
+        node * free_ = nullptr;
+        size_t free_ct_ = 0;
+        size_t max_free_;
+    };
+
+    inline void pooled_message::reset() {
+        if (!node_)
+            return;
+        auto n = node_;
+        node_ = nullptr;
+        if (n->refs_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        n->pool_->recycle(n);
+    }
+AZMQ_V1_INLINE_NAMESPACE_END
+} // namespace azmq
+#endif // AZMQ_MESSAGE_POOL_HPP_
@@ -0,0 +1,389 @@
+/*
+    Copyright (c) 2013-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of azmq
+
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef AZMQ_MESSAGE_VIEW_HPP_
+#define AZMQ_MESSAGE_VIEW_HPP_
+
+#include "message.hpp"
+
+#include <boost/assert.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/predef/other/endian.h>
+#include <boost/system/error_code.hpp>
+#include <boost/system/system_error.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+
+namespace azmq {
+AZMQ_V1_INLINE_NAMESPACE_BEGIN
+
+    enum class byte_order { little, big };
+
+#if BOOST_ENDIAN_BIG_BYTE
+    constexpr byte_order native_byte_order = byte_order::big;
+#else
+    constexpr byte_order native_byte_order = byte_order::little;
+#endif
+
+    /** \brief a field of type T at byte offset Offset of a layout, stored in byte order Order
+     *  \remark T must be an arithmetic or enum type. Fields are read and
+     *  written with a fixed size memcpy, which compiles to a plain load or
+     *  store, so a field need not be aligned, neither within the layout nor
+     *  in memory, and no per field copying code is needed.
+     */
+    template<typename T, size_t Offset, byte_order Order = byte_order::little>
+    struct field {
+        static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value,
+                      "field type must be arithmetic or enum");
+        static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8,
+                      "field type must be 1, 2, 4 or 8 bytes");
+
+        using value_type = T;
+        static const size_t offset = Offset;
+        static const size_t size = sizeof(T);
+        static const bool swap = sizeof(T) > 1 && Order != native_byte_order;
+    };
+
+    /** \brief N raw bytes at byte offset Offset of a layout, accessed as a buffer */
+    template<size_t Offset, size_t N>
+    struct bytes_field {
+        static const size_t offset = Offset;
+        static const size_t size = N;
+    };
+
+namespace detail {
+    constexpr bool fields_overlap(size_t a_off, size_t a_size, size_t b_off, size_t b_size) {
+        return a_off < b_off + b_size && b_off < a_off + a_size;
+    }
+
+    template<typename F, typename... Fs>
+    struct overlaps_any : std::false_type { };
+
+    template<typename F, typename G, typename... Fs>
+    struct overlaps_any<F, G, Fs...> : std::integral_constant<bool,
+        fields_overlap(F::offset, F::size, G::offset, G::size) || overlaps_any<F, Fs...>::value> { };
+
+    template<typename... Fs>
+    struct fields_disjoint : std::true_type { };
+
+    template<typename F, typename... Fs>
+    struct fields_disjoint<F, Fs...> : std::integral_constant<bool,
+        !overlaps_any<F, Fs...>::value && fields_disjoint<Fs...>::value> { };
+
+    template<size_t Size, typename... Fs>
+    struct fields_fit : std::true_type { };
+
+    template<size_t Size, typename F, typename... Fs>
+    struct fields_fit<Size, F, Fs...> : std::integral_constant<bool,
+        F::offset + F::size <= Size && fields_fit<Size, Fs...>::value> { };
+
+    template<typename F, typename... Fs>
+    struct is_one_of : std::false_type { };
+
+    template<typename F, typename G, typename... Fs>
+    struct is_one_of<F, G, Fs...> : std::integral_constant<bool,
+        std::is_same<F, G>::value || is_one_of<F, Fs...>::value> { };
+
+    template<size_t N> struct uint_of_size;
+    template<> struct uint_of_size<1> { using type = uint8_t; };
+    template<> struct uint_of_size<2> { using type = uint16_t; };
+    template<> struct uint_of_size<4> { using type = uint32_t; };
+    template<> struct uint_of_size<8> { using type = uint64_t; };
+
+    inline uint8_t byte_swap(uint8_t v) { return v; }
+#if defined(__GNUC__) || defined(__clang__)
+    inline uint16_t byte_swap(uint16_t v) { return __builtin_bswap16(v); }
+    inline uint32_t byte_swap(uint32_t v) { return __builtin_bswap32(v); }
+    inline uint64_t byte_swap(uint64_t v) { return __builtin_bswap64(v); }
+#else
+    inline uint16_t byte_swap(uint16_t v) {
+        return static_cast<uint16_t>((v << 8) | (v >> 8));
+    }
+    inline uint32_t byte_swap(uint32_t v) {
+        return (v << 24) | ((v << 8) & 0xff0000u) | ((v >> 8) & 0xff00u) | (v >> 24);
+    }
+    inline uint64_t byte_swap(uint64_t v) {
+        return (uint64_t(byte_swap(uint32_t(v))) << 32) | byte_swap(uint32_t(v >> 32));
+    }
+#endif
+
+    template<typename F>
+    typename F::value_type load_field(unsigned char const* p, std::false_type) {
+        typename F::value_type res;
+        std::memcpy(&res, p + F::offset, sizeof(res));
+        return res;
+    }
+
+    template<typename F>
+    typename F::value_type load_field(unsigned char const* p, std::true_type) {
+        using U = typename uint_of_size<F::size>::type;
+        U u;
+        std::memcpy(&u, p + F::offset, sizeof(u));
+        u = byte_swap(u);
+        typename F::value_type res;
+        std::memcpy(&res, &u, sizeof(res));
+        return res;
+    }
+
+    template<typename F>
+    void store_field(unsigned char * p, typename F::value_type v, std::false_type) {
+        std::memcpy(p + F::offset, &v, sizeof(v));
+    }
+
+    template<typename F>
+    void store_field(unsigned char * p, typename F::value_type v, std::true_type) {
+        using U = typename uint_of_size<F::size>::type;
+        U u;
+        std::memcpy(&u, &v, sizeof(u));
+        u = byte_swap(u);
+        std::memcpy(p + F::offset, &u, sizeof(u));
+    }
+
+    inline boost::system::error_code size_error() {
+        return boost::system::errc::make_error_code(boost::system::errc::message_size);
+    }
+} // namespace detail
+
+    /** \brief fixed layout of Size bytes made up of Fields
+     *  \remark Checked at compile time that every field lies within the
+     *  layout and that no two fields overlap. Messages may be longer than
+     *  Size, the remainder is available as the view's tail().
+     *  \code
+     *      using kind = azmq::field<uint8_t, 0>;
+     *      using length = azmq::field<uint32_t, 4, azmq::byte_order::big>;
+     *      using header = azmq::layout<8, kind, length>;
+     *
+     *      azmq::message_view<header> v(msg);
+     *      auto n = v.get<length>();
+     *  \endcode
+     */
+    template<size_t Size, typename... Fields>
+    struct layout {
+        static_assert(detail::fields_fit<Size, Fields...>::value, "field extends past the end of the layout");
+        static_assert(detail::fields_disjoint<Fields...>::value, "fields overlap");
+
+        static const size_t size = Size;
+
+        template<typename F>
+        struct has_field : detail::is_one_of<F, Fields...> { };
+    };
+
+    /** \brief read only, in place view of a buffer or message as a Layout
+     *  \remark The size is validated once on construction, field accesses
+     *  are then unchecked. The viewed data must outlive the view, so a view
+     *  cannot be made of a temporary message. Note that a message of
+     *  message::max_inline_size bytes or less holds its data inline, moving
+     *  such a message invalidates any view of it.
+     */
+    template<typename Layout>
+    class message_view {
+    public:
+        using layout_type = Layout;
+
+        message_view() BOOST_NOEXCEPT : data_(nullptr), size_(0) { }
+
+        /** \brief view buffer, which must hold at least Layout::size bytes
+         *  \throw boost::system::system_error
+         */
+        explicit message_view(boost::asio::const_buffer const& buffer)
+            : data_(nullptr), size_(0) {
+            boost::system::error_code ec;
+            if (!assign(buffer, ec))
+                throw boost::system::system_error(ec);
+        }
+
+        /** \brief view buffer, which must hold at least Layout::size bytes
+         *  \param ec set to errc::message_size if it does not
+         */
+        message_view(boost::asio::const_buffer const& buffer, boost::system::error_code & ec) BOOST_NOEXCEPT
+            : data_(nullptr), size_(0) {
+            assign(buffer, ec);
+        }
+
+        explicit message_view(message const& msg)
+            : message_view(msg.cbuffer())
+        { }
+
+        message_view(message const& msg, boost::system::error_code & ec) BOOST_NOEXCEPT
+            : message_view(msg.cbuffer(), ec)
+        { }
+
+        message_view(message &&) = delete;
+        message_view(message &&, boost::system::error_code &) = delete;
+
+        /** \brief whether the view refers to data */
+        explicit operator bool() const BOOST_NOEXCEPT { return data_ != nullptr; }
+
+        template<typename F>
+        typename F::value_type get() const BOOST_NOEXCEPT {
+            static_assert(Layout::template has_field<F>::value, "field is not part of the layout");
+            BOOST_ASSERT_MSG(data_, "empty message_view");
+            return detail::load_field<F>(data_, std::integral_constant<bool, F::swap>());
+        }
+
+        template<typename F>
+        boost::asio::const_buffer bytes() const BOOST_NOEXCEPT {
+            static_assert(Layout::template has_field<F>::value, "field is not part of the layout");
+            BOOST_ASSERT_MSG(data_, "empty message_view");
+            return boost::asio::buffer(data_ + F::offset, F::size);
+        }
+
+        /** \brief the data following the layout */
+        boost::asio::const_buffer tail() const BOOST_NOEXCEPT {
+            return data_ ? boost::asio::buffer(data_ + Layout::size, size_ - Layout::size)
+                         : boost::asio::const_buffer();
+        }
+
+        /** \brief the whole viewed data */
+        boost::asio::const_buffer buffer() const BOOST_NOEXCEPT {
+            return boost::asio::buffer(data_, size_);
+        }
+
+    protected:
+        bool assign(boost::asio::const_buffer const& buffer, boost::system::error_code & ec) BOOST_NOEXCEPT {
+            auto size = boost::asio::buffer_size(buffer);
+            if (size < Layout::size) {
+                ec = detail::size_error();
+                return false;
+            }
+            data_ = const_cast<unsigned char*>(boost::asio::buffer_cast<unsigned char const*>(buffer));
+            size_ = size;
+            ec = boost::system::error_code();
+            return true;
+        }
+
+        // only written through by mutable_message_view
+        unsigned char * data_;
+        size_t size_;
+    };
+
+    /** \brief in place view of a writable buffer or message as a Layout
+     *  \remark Writing through the buffer of a message which shares its data
+     *  with copies changes every copy. As for message_view, moving a message
+     *  of message::max_inline_size bytes or less invalidates any view of it.
+     */
+    template<typename Layout>
+    class mutable_message_view : public message_view<Layout> {
+        using base_type = message_view<Layout>;
+    public:
+        mutable_message_view() BOOST_NOEXCEPT { }
+
+        /** \throw boost::system::system_error */
+        explicit mutable_message_view(boost::asio::mutable_buffer const& buffer)
+            : base_type(boost::asio::const_buffer(buffer))
+        { }
+
+        mutable_message_view(boost::asio::mutable_buffer const& buffer, boost::system::error_code & ec) BOOST_NOEXCEPT
+            : base_type(boost::asio::const_buffer(buffer), ec)
+        { }
+
+        explicit mutable_message_view(message & msg)
+            : mutable_message_view(msg.buffer())
+        { }
+
+        mutable_message_view(message & msg, boost::system::error_code & ec)
+            : mutable_message_view(msg.buffer(), ec)
+        { }
+
+        mutable_message_view(message &&) = delete;
+        mutable_message_view(message &&, boost::system::error_code &) = delete;
+
+        template<typename F>
+        void set(typename F::value_type v) BOOST_NOEXCEPT {
+            static_assert(Layout::template has_field<F>::value, "field is not part of the layout");
+            BOOST_ASSERT_MSG(this->data_, "empty message_view");
+            detail::store_field<F>(this->data_, v, std::integral_constant<bool, F::swap>());
+        }
+
+        template<typename F>
+        boost::asio::mutable_buffer mutable_bytes() BOOST_NOEXCEPT {
+            static_assert(Layout::template has_field<F>::value, "field is not part of the layout");
+            BOOST_ASSERT_MSG(this->data_, "empty message_view");
+            return boost::asio::buffer(this->data_ + F::offset, F::size);
+        }
+    };
+
+    /** \brief in place views of the parts of a multipart message, one Layout per part
+     *  \remark The number of parts and the size of each is validated once
+     *  on construction. The messages must outlive the view.
+     */
+    template<typename... Layouts>
+    class multipart_view {
+    public:
+        static const size_t parts = sizeof...(Layouts);
+
+        template<size_t I>
+        using view_type = message_view<typename std::tuple_element<I, std::tuple<Layouts...>>::type>;
+
+        /** \brief view the messages in [first, last)
+         *  \param ec set to errc::message_size if the number of parts differs
+         *  or a part is too short
+         */
+        template<typename Iterator>
+        multipart_view(Iterator first, Iterator last, boost::system::error_code & ec) {
+            assign(first, last, ec);
+        }
+
+        /** \throw boost::system::system_error */
+        template<typename Iterator>
+        multipart_view(Iterator first, Iterator last) {
+            boost::system::error_code ec;
+            if (!assign(first, last, ec))
+                throw boost::system::system_error(ec);
+        }
+
+        /** \brief view a message_vector, multipart_buffer or other range of message */
+        template<typename MessageRange>
+        multipart_view(MessageRange const& parts, boost::system::error_code & ec)
+            : multipart_view(std::begin(parts), std::end(parts), ec)
+        { }
+
+        /** \throw boost::system::system_error */
+        template<typename MessageRange>
+        explicit multipart_view(MessageRange const& parts)
+            : multipart_view(std::begin(parts), std::end(parts))
+        { }
+
+        template<size_t I>
+        view_type<I> const& part() const BOOST_NOEXCEPT {
+            return std::get<I>(views_);
+        }
+
+    private:
+        template<typename Iterator>
+        bool assign(Iterator first, Iterator last, boost::system::error_code & ec) {
+            if (static_cast<size_t>(std::distance(first, last)) != parts) {
+                ec = detail::size_error();
+                return false;
+            }
+            ec = boost::system::error_code();
+            return assign_part(first, ec, std::integral_constant<size_t, 0>());
+        }
+
+        template<typename Iterator, size_t I>
+        bool assign_part(Iterator it, boost::system::error_code & ec, std::integral_constant<size_t, I>) {
+            std::get<I>(views_) = view_type<I>(*it, ec);
+            if (ec)
+                return false;
+            return assign_part(++it, ec, std::integral_constant<size_t, I + 1>());
+        }
+
+        template<typename Iterator>
+        bool assign_part(Iterator, boost::system::error_code &, std::integral_constant<size_t, parts>) {
+            return true;
+        }
+
+        std::tuple<message_view<Layouts>...> views_;
+    };
+AZMQ_V1_INLINE_NAMESPACE_END
+} // namespace azmq
+#endif // AZMQ_MESSAGE_VIEW_HPP_
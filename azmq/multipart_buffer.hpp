@@ -0,0 +1,84 @@
+/*
+    Copyright (c) 2013-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of azmq
+
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef AZMQ_MULTIPART_BUFFER_HPP_
+#define AZMQ_MULTIPART_BUFFER_HPP_
+
+#include "message.hpp"
+
+#include <boost/assert.hpp>
+
+#include <vector>
+
+namespace azmq {
+namespace detail {
+    struct socket_ops;
+}
+
+AZMQ_V1_INLINE_NAMESPACE_BEGIN
+
+    /** \brief fixed capacity, reusable container for the parts of a multipart message
+     *  \remark All capacity() message slots are created up front and are never
+     *  destroyed by clear() or by a subsequent receive, libzmq releases the previous
+     *  content of a slot as it receives into it. Receiving into the same
+     *  multipart_buffer repeatedly therefore neither allocates nor initialises
+     *  messages, e.g. for ROUTER identity/delimiter/body envelopes.
+     */
+    class multipart_buffer {
+    public:
+        using value_type = message;
+        using iterator = message*;
+        using const_iterator = message const*;
+
+        explicit multipart_buffer(size_t capacity)
+            : slots_(capacity)
+        {
+            BOOST_ASSERT_MSG(capacity, "capacity must be non-zero");
+        }
+
+        size_t size() const { return size_; }
+        size_t capacity() const { return slots_.size(); }
+        bool empty() const { return size_ == 0; }
+
+        /** \brief mark the buffer empty, slots keep their frames until reused */
+        void clear() { size_ = 0; }
+
+        message & operator[](size_t i) {
+            BOOST_ASSERT_MSG(i < size_, "index out of range");
+            return slots_[i];
+        }
+
+        message const& operator[](size_t i) const {
+            BOOST_ASSERT_MSG(i < size_, "index out of range");
+            return slots_[i];
+        }
+
+        message & front() { return (*this)[0]; }
+        message const& front() const { return (*this)[0]; }
+        message & back() { return (*this)[size_ - 1]; }
+        message const& back() const { return (*this)[size_ - 1]; }
+
+        iterator begin() { return slots_.data(); }
+        iterator end() { return slots_.data() + size_; }
+        const_iterator begin() const { return slots_.data(); }
+        const_iterator end() const { return slots_.data() + size_; }
+
+    private:
+        friend struct detail::socket_ops;
+
+        // next free slot, or nullptr when full
+        message * next_slot() {
+            return size_ < slots_.size() ? &slots_[size_++] : nullptr;
+        }
+
+        std::vector<message> slots_;
+        size_t size_ = 0;
+    };
+AZMQ_V1_INLINE_NAMESPACE_END
+} // namespace azmq
+#endif // AZMQ_MULTIPART_BUFFER_HPP_
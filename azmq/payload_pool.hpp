@@ -0,0 +1,311 @@
+/*
+    Copyright (c) 2013-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of azmq
+
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef AZMQ_PAYLOAD_POOL_HPP_
+#define AZMQ_PAYLOAD_POOL_HPP_
+
+#include "message.hpp"
+
+#include <boost/assert.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#if defined(__linux__) && !defined(AZMQ_DISABLE_PAYLOAD_POOL_MMAP)
+#   define AZMQ_DETAIL_HAS_PAYLOAD_POOL_MMAP 1
+#endif
+
+#ifdef AZMQ_DETAIL_HAS_PAYLOAD_POOL_MMAP
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace azmq {
+AZMQ_V1_INLINE_NAMESPACE_BEGIN
+
+    /** \brief pool of large, pre-faulted payload blocks for message
+     *  \remark Intended for multi-megabyte frames, where allocating with
+     *  malloc per message costs page faults and, on multi-socket machines,
+     *  may place the payload on a remote NUMA node. Blocks of block_size()
+     *  bytes are mapped with huge pages when available (MAP_HUGETLB, falling
+     *  back to transparent huge pages via madvise and then to normal pages),
+     *  bound to the NUMA node of the allocating thread and touched up front,
+     *  and are kept in a free list per node for reuse. Messages refer to
+     *  their block through a plain zmq_free_fn, which returns the block to
+     *  its node's free list from whichever thread libzmq releases it on.
+     *
+     *  Requests larger than block_size() are allocated by libzmq as usual.
+     *  Thread safe. Outside Linux, or with AZMQ_DISABLE_PAYLOAD_POOL_MMAP
+     *  defined, blocks come from operator new and every thread uses node 0.
+     */
+    class payload_pool {
+    public:
+        enum flags_type : unsigned {
+            use_huge_pages = 1,
+            bind_to_node = 2,
+            prefault = 4,
+            default_flags = use_huge_pages | bind_to_node | prefault
+        };
+
+        enum : size_t {
+            default_block_size = 4 * 1024 * 1024,
+            max_nodes = 64
+        };
+
+        explicit payload_pool(size_t block_size = default_block_size,
+                              size_t max_free_per_node = 16,
+                              unsigned flags = default_flags)
+            : state_(std::make_shared<state>(block_size, max_free_per_node, flags))
+        { }
+
+        payload_pool(payload_pool const&) = delete;
+        payload_pool& operator=(payload_pool const&) = delete;
+
+        size_t block_size() const { return state_->block_size_; }
+
+        /** \brief a message of size uninitialised bytes */
+        message allocate(size_t size) {
+            if (size <= message::max_inline_size || size > block_size())
+                return message(size);
+
+            auto b = state_->acquire(current_node());
+            return message(nocopy, boost::asio::buffer(b->data(), size), b, &release);
+        }
+
+        /** \brief a message holding a copy of buffer */
+        message allocate(boost::asio::const_buffer const& buffer) {
+            auto res = allocate(boost::asio::buffer_size(buffer));
+            boost::asio::buffer_copy(res.buffer(), buffer);
+            return res;
+        }
+
+        /** \brief map count blocks on the calling thread's node ahead of use
+         *  \remark Call at startup from each thread that will allocate, blocks
+         *  beyond the free list limit are not retained.
+         */
+        void reserve(size_t count) {
+            auto node = current_node();
+            std::vector<block*> bs;
+            for (size_t i = 0; i != count; ++i)
+                bs.push_back(state_->acquire(node));
+            for (auto b : bs)
+                recycle(b);
+        }
+
+        /** \brief NUMA node of the calling thread, 0 if unknown */
+        static unsigned current_node() {
+#if defined(AZMQ_DETAIL_HAS_PAYLOAD_POOL_MMAP) && defined(SYS_getcpu)
+            unsigned cpu = 0;
+            unsigned node = 0;
+            if (::syscall(SYS_getcpu, &cpu, &node, nullptr) == 0 && node < max_nodes)
+                return node;
+#endif
+            return 0;
+        }
+
+        /** \brief blocks mapped so far, for diagnostics */
+        size_t blocks_mapped() const {
+            return state_->mapped_.load(std::memory_order_relaxed);
+        }
+
+        /** \brief blocks mapped so far which are backed by MAP_HUGETLB pages */
+        size_t huge_page_blocks() const {
+            return state_->huge_.load(std::memory_order_relaxed);
+        }
+
+        /** \brief idle blocks held for node */
+        size_t free_count(unsigned node) const {
+            BOOST_ASSERT_MSG(node < max_nodes, "node out of range");
+            auto & n = state_->nodes_[node];
+            boost::unique_lock<boost::mutex> l{ n.mutex_ };
+            return n.free_.size();
+        }
+
+    private:
+        struct state;
+        using lock_type = boost::unique_lock<boost::mutex>;
+
+        enum : size_t {
+            header_size = 64,
+            huge_page_size = 2 * 1024 * 1024
+        };
+
+        // header at the start of each block's mapping, followed by the payload
+        struct block {
+            std::shared_ptr<state> state_;
+            size_t mapped_size_;
+            unsigned node_;
+            bool huge_;
+            bool mapped_;
+
+            unsigned char * data() {
+                return reinterpret_cast<unsigned char*>(this) + header_size;
+            }
+        };
+        static_assert(sizeof(block) <= header_size, "block header overlaps the payload");
+
+        struct node_pool {
+            mutable boost::mutex mutex_;
+            std::vector<block*> free_;
+        };
+
+        struct state : std::enable_shared_from_this<state> {
+            state(size_t block_size, size_t max_free, unsigned flags)
+                : block_size_(block_size)
+                , max_free_(max_free)
+                , flags_(flags)
+            {
+                BOOST_ASSERT_MSG(block_size > message::max_inline_size, "block_size too small");
+            }
+
+            ~state() {
+                for (auto & n : nodes_) {
+                    for (auto b : n.free_)
+                        unmap(b);
+                }
+            }
+
+            block * acquire(unsigned node) {
+                auto & n = nodes_[node];
+                block * b = nullptr;
+                {
+                    lock_type l{ n.mutex_ };
+                    if (!n.free_.empty()) {
+                        b = n.free_.back();
+                        n.free_.pop_back();
+                    }
+                }
+                if (!b)
+                    b = map(node);
+                b->state_ = shared_from_this();
+                return b;
+            }
+
+            block * map(unsigned node) {
+                auto size = header_size + block_size_;
+                void * p = nullptr;
+                bool huge = false;
+                bool mapped = false;
+#ifdef AZMQ_DETAIL_HAS_PAYLOAD_POOL_MMAP
+                size = round_up(size, static_cast<size_t>(::sysconf(_SC_PAGESIZE)));
+#ifdef MAP_HUGETLB
+                if (flags_ & use_huge_pages) {
+                    auto hsize = round_up(size, huge_page_size);
+                    p = ::mmap(nullptr, hsize, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                    if (p != MAP_FAILED) {
+                        size = hsize;
+                        huge = true;
+                    }
+                }
+#endif
+                if (!huge) {
+                    p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                    if (p == MAP_FAILED)
+                        throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+                    if ((flags_ & use_huge_pages) && size >= huge_page_size)
+                        ::madvise(p, size, MADV_HUGEPAGE);
+#endif
+                }
+                mapped = true;
+                if (flags_ & bind_to_node)
+                    bind(p, size, node);
+                if (flags_ & prefault) {
+                    auto step = huge ? size_t(huge_page_size) : static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+                    auto pc = static_cast<volatile unsigned char*>(p);
+                    for (size_t i = 0; i < size; i += step)
+                        pc[i] = 0;
+                }
+#else
+                p = ::operator new(size);
+#endif
+                auto b = new (p) block();
+                b->mapped_size_ = size;
+                b->node_ = node;
+                b->huge_ = huge;
+                b->mapped_ = mapped;
+                mapped_.fetch_add(1, std::memory_order_relaxed);
+                if (huge)
+                    huge_.fetch_add(1, std::memory_order_relaxed);
+                return b;
+            }
+
+            static void unmap(block * b) {
+                auto size = b->mapped_size_;
+                auto mapped = b->mapped_;
+                b->~block();
+#ifdef AZMQ_DETAIL_HAS_PAYLOAD_POOL_MMAP
+                if (mapped) {
+                    ::munmap(b, size);
+                    return;
+                }
+#endif
+                (void)size;
+                (void)mapped;
+                ::operator delete(b);
+            }
+
+            static size_t round_up(size_t n, size_t to) {
+                return (n + to - 1) / to * to;
+            }
+
+            // MPOL_PREFERRED through the raw syscall, so as not to require
+            // libnuma. Failure (no NUMA support, or not permitted) is ignored
+            // and leaves the default first touch placement.
+            static void bind(void * p, size_t size, unsigned node) {
+#if defined(AZMQ_DETAIL_HAS_PAYLOAD_POOL_MMAP) && defined(SYS_mbind)
+                const int mpol_preferred = 1;
+                unsigned long mask = 1ul << node;
+                ::syscall(SYS_mbind, p, size, mpol_preferred, &mask, sizeof(mask) * 8 + 1, 0);
+#else
+                (void)p;
+                (void)size;
+                (void)node;
+#endif
+            }
+
+            size_t block_size_;
+            size_t max_free_;
+            unsigned flags_;
+            std::array<node_pool, max_nodes> nodes_;
+            std::atomic<size_t> mapped_{ 0 };
+            std::atomic<size_t> huge_{ 0 };
+        };
+
+        static void recycle(block * b) {
+            // the block may hold the last reference to its pool
+            auto s = std::move(b->state_);
+            auto & n = s->nodes_[b->node_];
+            {
+                lock_type l{ n.mutex_ };
+                if (n.free_.size() < s->max_free_) {
+                    n.free_.push_back(b);
+                    return;
+                }
+            }
+            state::unmap(b);
+        }
+
+        static void release(void *, void * hint) {
+            recycle(static_cast<block*>(hint));
+        }
+
+        std::shared_ptr<state> state_;
+    };
+AZMQ_V1_INLINE_NAMESPACE_END
+} // namespace azmq
+#endif // AZMQ_PAYLOAD_POOL_HPP_
@@ -13,22 +13,60 @@
 #include "option.hpp"
 #include "context.hpp"
 #include "message.hpp"
+#include "message_pool.hpp"
+#include "multipart_buffer.hpp"
+#include "frame_ring.hpp"
 #include "detail/basic_io_object.hpp"
 #include "detail/send_op.hpp"
 #include "detail/receive_op.hpp"
+#include "detail/initiate_async.hpp"
 
 #include <boost/asio/basic_io_object.hpp>
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/buffer.hpp>
 #include <boost/system/error_code.hpp>
+#include <boost/system/system_error.hpp>
+#include <boost/version.hpp>
+#if BOOST_VERSION >= 106600
+#   include <boost/asio/post.hpp>
+#endif
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <ostream>
 #include <type_traits>
+#include <vector>
 
 namespace azmq {
 AZMQ_V1_INLINE_NAMESPACE_BEGIN
 
+/** \brief counts of frames, bytes and reactor activity of a socket, see socket::stats() */
+using socket_stats = detail::socket_stats;
+
+/** \brief stream manipulator having operator<< for socket print the socket's counters */
+inline std::ostream& show_stats(std::ostream& stm) {
+    stm.iword(detail::show_stats_index()) = 1;
+    return stm;
+}
+
+/** \brief stream manipulator undoing show_stats, the default */
+inline std::ostream& noshow_stats(std::ostream& stm) {
+    stm.iword(detail::show_stats_index()) = 0;
+    return stm;
+}
+
 /** \brief Implement an asio-like socket over a zeromq socket
  *  \remark sockets are movable, but not copyable
+ *  \remark Each async_ operation accepts either a handler or an asio
+ *  completion token, such as use_future, a yield_context or, with C++20
+ *  coroutines, use_awaitable, and returns whatever the token's async_result
+ *  produces. Completion signatures are those of the documented handlers.
+ *  Note that Boost.Asio's yield_context only supports signatures of up to
+ *  two arguments, which excludes the message, pooled, ring and batch
+ *  receives.
  */
 class socket :
     public azmq::detail::basic_io_object<detail::socket_service> {
@@ -42,6 +80,13 @@ public:
 
     // socket options
     using allow_speculative = detail::socket_service::allow_speculative;
+    using speculative_window = detail::socket_service::speculative_window;
+    using events_query_count = detail::socket_service::events_query_count;
+#ifdef AZMQ_ENABLE_OP_TRACING
+    // read only, queue wait and completion latency histograms and speculative
+    // hit counts of this socket's async ops, see detail/op_trace.hpp
+    using op_trace_stats = detail::socket_service::op_trace_stats;
+#endif
     using type = opt::integer<ZMQ_TYPE>;
     using rcv_more = opt::integer<ZMQ_RCVMORE>;
     using rcv_hwm = opt::integer<ZMQ_RCVHWM>;
@@ -110,6 +155,26 @@ public:
             throw boost::system::system_error(ec);
     }
 
+    /** \brief socket constructor
+     *  \param strand reference to an asio::io_service::strand
+     *  \param s_type int socket type
+     *      For socket types see the zeromq documentation
+     *  \remarks
+     *      All of the socket's internal completions, and the handlers of
+     *      the operations it initiates, are serialized through the supplied
+     *      strand. Provided the socket is only used from that strand this
+     *      removes the need for the per socket mutex, so the socket may be
+     *      used with an io_service which is run from several threads
+     *      without paying for locking on every operation.
+     */
+    socket(boost::asio::io_service::strand& strand,
+           int type)
+            : azmq::detail::basic_io_object<detail::socket_service>(detail::socket_service::context_of(strand)) {
+        boost::system::error_code ec;
+        if (get_service().do_open(get_implementation(), type, strand, ec))
+            throw boost::system::system_error(ec);
+    }
+
     socket(socket&& other)
         : azmq::detail::basic_io_object<detail::socket_service>(other.get_io_service()) {
         get_service().move_construct(get_implementation(),
@@ -405,6 +470,37 @@ public:
         return res;
     }
 
+    /** \brief Receive all parts of a multipart message into a reusable buffer
+     *  \param buf multipart_buffer to fill on receive, its previous contents are replaced
+     *  \flags specifying how the receive call is to be made
+     *  \param ec set to indicate what error, if any, occurred
+     *  \return size_t bytes transferred
+     *  \remark
+     *  If the message has more parts than buf.capacity(), ec is set to
+     *  no_buffer_space and the remaining parts are left on the socket, they
+     *  may be collected with receive_more() or discarded with flush().
+     */
+    size_t receive_multipart(multipart_buffer & buf,
+                             flags_type flags,
+                             boost::system::error_code & ec) {
+        return get_service().receive_multipart(get_implementation(), buf, flags, ec);
+    }
+
+    /** \brief Receive all parts of a multipart message into a reusable buffer
+     *  \param buf multipart_buffer to fill on receive, its previous contents are replaced
+     *  \flags specifying how the receive call is to be made
+     *  \return size_t bytes transferred
+     *  \throw boost::system::system_error
+     */
+    size_t receive_multipart(multipart_buffer & buf,
+                             flags_type flags = 0) {
+        boost::system::error_code ec;
+        auto res = receive_multipart(buf, flags, ec);
+        if (ec)
+            throw boost::system::system_error(ec);
+        return res;
+    }
+
     /** \brief Send some data from the socket
      *  \tparam ConstBufferSequence
      *  \param buffers buffer(s) to send
@@ -440,6 +536,36 @@ public:
         return res;
     }
 
+    /** \brief Send a buffer sequence as a single message part
+     *  \tparam ConstBufferSequence
+     *  \param buffers buffer(s) to concatenate
+     *  \param flags specifying how the send call is to be made
+     *  \param ec set to indicate what, if any, error occurred
+     *  \remark
+     *  The part is allocated once, for the total size, and each buffer copied
+     *  into it in turn, see message(gather_t, ConstBufferSequence const&).
+     */
+    template<typename ConstBufferSequence>
+    std::size_t send(gather_t,
+                     ConstBufferSequence const& buffers,
+                     flags_type flags,
+                     boost::system::error_code & ec) {
+        return send(message(gather, buffers), flags, ec);
+    }
+
+    /** \brief Send a buffer sequence as a single message part
+     *  \tparam ConstBufferSequence
+     *  \param buffers buffer(s) to concatenate
+     *  \param flags specifying how the send call is to be made
+     *  \throw boost::system::system_error
+     */
+    template<typename ConstBufferSequence>
+    std::size_t send(gather_t,
+                     ConstBufferSequence const& buffers,
+                     flags_type flags = 0) {
+        return send(message(gather, buffers), flags);
+    }
+
     /** \brief Send some data from the socket
      *  \param msg raw_message to send
      *  \param flags specifying how the send call is to be made
@@ -503,12 +629,13 @@ public:
      */
     template<typename MutableBufferSequence,
              typename ReadHandler>
-    void async_receive(MutableBufferSequence const& buffers,
-                       ReadHandler && handler,
-                       flags_type flags = 0) {
-        using type = detail::receive_buffer_op<MutableBufferSequence, ReadHandler>;
-        get_service().enqueue<type>(get_implementation(), detail::socket_service::op_type::read_op,
-                                    buffers, std::forward<ReadHandler>(handler), flags);
+    AZMQ_INITFN_RESULT_TYPE(ReadHandler, void(boost::system::error_code, size_t))
+    async_receive(MutableBufferSequence const& buffers,
+                  ReadHandler && handler,
+                  flags_type flags = 0) {
+        return detail::initiate_async<ReadHandler, void(boost::system::error_code, size_t)>(
+                initiate<detail::receive_buffer_op, MutableBufferSequence>(detail::socket_service::op_type::read_op),
+                handler, buffers, flags);
     }
 
     /** \brief Initiate an async receive operation.
@@ -532,12 +659,13 @@ public:
      */
     template<typename MutableBufferSequence,
              typename ReadMoreHandler>
-    void async_receive_more(MutableBufferSequence const& buffers,
-                            ReadMoreHandler && handler,
-                            flags_type flags = 0) {
-        using type = detail::receive_more_buffer_op<MutableBufferSequence, ReadMoreHandler>;
-        get_service().enqueue<type>(get_implementation(), detail::socket_service::op_type::read_op,
-                                    buffers, std::forward<ReadMoreHandler>(handler), flags);
+    AZMQ_INITFN_RESULT_TYPE(ReadMoreHandler, void(boost::system::error_code, more_result_type))
+    async_receive_more(MutableBufferSequence const& buffers,
+                       ReadMoreHandler && handler,
+                       flags_type flags = 0) {
+        return detail::initiate_async<ReadMoreHandler, void(boost::system::error_code, more_result_type)>(
+                initiate<detail::receive_more_buffer_op, MutableBufferSequence>(detail::socket_service::op_type::read_op),
+                handler, buffers, flags);
     }
 
     /** \brief Initate an async receive operation
@@ -559,11 +687,157 @@ public:
      *  the message.
      */
     template<typename MessageReadHandler>
-    void async_receive(MessageReadHandler && handler,
+    AZMQ_INITFN_RESULT_TYPE(MessageReadHandler, void(boost::system::error_code, message &, size_t))
+    async_receive(MessageReadHandler && handler,
+                  flags_type flags = 0) {
+        return detail::initiate_async<MessageReadHandler, void(boost::system::error_code, message &, size_t)>(
+                initiate<detail::receive_op>(detail::socket_service::op_type::read_op),
+                handler, flags);
+    }
+
+    /** \brief Initiate a standing async receive, calling handler for every frame until cancelled
+     *  \tparam MessageReadHandler must conform to the MessageReadHandler concept
+     *  \param handler MessageReadHandler
+     *  \param flags int flags
+     *  \param max_batch size_t most frames received per reactor wakeup
+     *  \remark
+     *  Unlike async_receive(), a single op stays installed on the socket: it is
+     *  allocated once, receives into message slots it reuses, and after
+     *  handing every frame it received to handler takes the socket's lock once
+     *  to put itself back on the queue. Each part of a multipart message is
+     *  passed as its own frame, check msg.more() for message boundaries. As
+     *  for async_receive(), handler must copy or move msg to keep it.
+     *  \remark
+     *  handler is called a final time with an error and an empty message when
+     *  the receive ends, operation_aborted after cancel(), a receive shutdown
+     *  or the socket's destruction, and is only destroyed then. Completion
+     *  tokens are not supported, handler is called many times.
+     */
+    template<typename MessageReadHandler>
+    void async_receive_continuous(MessageReadHandler && handler,
+                                  flags_type flags = 0,
+                                  size_t max_batch = 16) {
+        using op_type = detail::receive_continuous_op<detail::socket_service,
+                                                      typename std::decay<MessageReadHandler>::type>;
+        get_service().enqueue<op_type>(get_implementation(), detail::socket_service::op_type::read_op,
+                                       std::forward<MessageReadHandler>(handler),
+                                       get_service(), get_implementation(), max_batch, flags);
+    }
+
+    /** \brief Initiate an async receive into a message leased from the socket's pool
+     *  \tparam PooledReadHandler must conform to the PooledReadHandler concept
+     *  \param handler PooledReadHandler
+     *  \param flags int flags
+     *  \remark
+     *  The PooledReadHandler concept has the following interface
+     *  struct PooledReadHandler {
+     *      void operator()(const boost::system::error_code & ec,
+     *                      pooled_message & msg,
+     *                      size_t bytes_transferred);
+     *  }
+     *  \remark
+     *  The frame is received straight into a message taken from a per-socket
+     *  free list, and is never copied into user buffers. The handler may parse
+     *  it in place via msg->cbuffer(), and may keep msg beyond the handler by
+     *  copying the pooled_message; the message returns to the pool when the
+     *  last copy is destroyed.
+     */
+    template<typename PooledReadHandler>
+    AZMQ_INITFN_RESULT_TYPE(PooledReadHandler, void(boost::system::error_code, pooled_message &, size_t))
+    async_receive_pooled(PooledReadHandler && handler,
+                         flags_type flags = 0) {
+        return detail::initiate_async<PooledReadHandler, void(boost::system::error_code, pooled_message &, size_t)>(
+                initiate<detail::receive_pooled_op>(detail::socket_service::op_type::read_op),
+                handler, detail::socket_service::message_pool_slot(get_implementation()), flags);
+    }
+
+    /** \brief The message pool used by async_receive_pooled
+     *  \remark Created on first use
+     */
+    std::shared_ptr<message_pool> get_message_pool() {
+        return get_service().get_message_pool(get_implementation());
+    }
+
+    /** \brief Initiate an async receive of all parts of a multipart message
+     *  \tparam ReadHandler must conform to the asio ReadHandler concept
+     *  \param buf multipart_buffer to fill, its previous contents are replaced
+     *  \param handler ReadHandler
+     *  \param flags int flags
+     *  \remark
+     *  buf must remain valid until the handler is called. Parts are received
+     *  into buf's existing message slots, so reusing one multipart_buffer across
+     *  receives does no per-message allocation. As with receive_multipart(),
+     *  no_buffer_space is reported if the message has more than buf.capacity() parts.
+     */
+    template<typename ReadHandler>
+    AZMQ_INITFN_RESULT_TYPE(ReadHandler, void(boost::system::error_code, size_t))
+    async_receive_multipart(multipart_buffer & buf,
+                            ReadHandler && handler,
+                            flags_type flags = 0) {
+        return detail::initiate_async<ReadHandler, void(boost::system::error_code, size_t)>(
+                initiate<detail::receive_multipart_op>(detail::socket_service::op_type::read_op),
+                handler, std::ref(buf), flags);
+    }
+
+    /** \brief Initiate an async receive of frames into a frame_ring
+     *  \tparam RingReadHandler must conform to the RingReadHandler concept
+     *  \param ring frame_ring to append frames to
+     *  \param handler RingReadHandler
+     *  \param flags int flags
+     *  \remark
+     *  The RingReadHandler concept has the following interface
+     *  struct RingReadHandler {
+     *      void operator()(const boost::system::error_code & ec,
+     *                      size_t frames,
+     *                      size_t bytes_transferred);
+     *  }
+     *  \remark
+     *  Once the socket becomes readable every frame already queued on it is
+     *  appended to ring, each message part as its own frame, until none remain
+     *  or ring is full; frames and bytes_transferred report how many were
+     *  written by this completion. A frame which did not fit is held by ring and
+     *  written first by the next receive. If ring has no room for even one
+     *  frame ec is no_buffer_space, frames larger than ring.max_frame_size()
+     *  are discarded with the same error. ring must remain valid until the
+     *  handler is called.
+     */
+    template<typename RingReadHandler>
+    AZMQ_INITFN_RESULT_TYPE(RingReadHandler, void(boost::system::error_code, size_t, size_t))
+    async_receive_ring(frame_ring & ring,
+                       RingReadHandler && handler,
                        flags_type flags = 0) {
-        using type = detail::receive_op<MessageReadHandler>;
-        get_service().enqueue<type>(get_implementation(), detail::socket_service::op_type::read_op,
-                                    std::forward<MessageReadHandler>(handler), flags);
+        return detail::initiate_async<RingReadHandler, void(boost::system::error_code, size_t, size_t)>(
+                initiate<detail::receive_ring_op>(detail::socket_service::op_type::read_op),
+                handler, std::ref(ring), flags);
+    }
+
+    /** \brief Initiate an async receive of up to max_msgs messages
+     *  \tparam MessageBatchReadHandler must conform to the MessageBatchReadHandler concept
+     *  \param max_msgs size_t maximum number of messages to collect
+     *  \param handler MessageBatchReadHandler
+     *  \param flags int flags
+     *  \remark
+     *  The MessageBatchReadHandler concept has the following interface
+     *  struct MessageBatchReadHandler {
+     *      void operator()(const boost::system::error_code & ec,
+     *                      message_vector & msgs,
+     *                      size_t bytes_transferred);
+     *  }
+     *  \remark
+     *  Once the socket becomes readable, every message already queued on it,
+     *  up to max_msgs, is drained in a single reactor callback and handed to
+     *  the handler at once. All parts of a multipart message are collected, so
+     *  msgs may hold more than max_msgs parts; use message::more() to find the
+     *  message boundaries.
+     */
+    template<typename MessageBatchReadHandler>
+    AZMQ_INITFN_RESULT_TYPE(MessageBatchReadHandler, void(boost::system::error_code, message_vector &, size_t))
+    async_receive_batch(size_t max_msgs,
+                        MessageBatchReadHandler && handler,
+                        flags_type flags = 0) {
+        return detail::initiate_async<MessageBatchReadHandler, void(boost::system::error_code, message_vector &, size_t)>(
+                initiate<detail::receive_batch_op>(detail::socket_service::op_type::read_op),
+                handler, max_msgs, flags);
     }
 
     /** \brief Initiate an async send operation
@@ -575,15 +849,80 @@ public:
      *  \remark
      *  If buffers is a sequence of buffers, this call will send a multipart
      *  message from the supplied buffer sequence.
+     *  \remark
+     *  As with asio, the buffer sequence itself is copied and need not outlive
+     *  the call, but the memory it refers to must remain valid until the
+     *  handler is called.
+     */
+    template<typename ConstBufferSequence,
+             typename WriteHandler>
+    AZMQ_INITFN_RESULT_TYPE(WriteHandler, void(boost::system::error_code, size_t))
+    async_send(ConstBufferSequence const& buffers,
+               WriteHandler && handler,
+               flags_type flags = 0) {
+        return detail::initiate_async<WriteHandler, void(boost::system::error_code, size_t)>(
+                initiate<detail::send_buffer_op, ConstBufferSequence>(detail::socket_service::op_type::write_op),
+                handler, buffers, flags);
+    }
+
+    /** \brief Initiate an async send operation which does not copy the buffers
+     *  \tparam ConstBufferSequence must conform to the asio
+     *          ConstBufferSequence concept
+     *  \tparam WriteHandler must conform to the asio
+     *          WriteHandler concept
+     *  \param buffers ConstBufferSequence, each buffer is sent as a message
+     *          part referring directly to the buffer's memory
+     *  \param handler WriteHandler
+     *  \param flags specifying how the send call is to be made
+     *  \remark
+     *  The memory referred to by buffers must remain valid and unmodified
+     *  until the handler is called. The handler is not called until libzmq
+     *  has released every part, which may be some time after the parts were
+     *  queued, e.g. for an inproc peer not until it has closed the
+     *  received message. Worthwhile for large frames, small ones are cheaper
+     *  to copy than to track.
+     *
+     *  Parts already handed to libzmq do not keep the io_service's run()
+     *  from returning. If it runs out of other work first, run() returns
+     *  and the handler is called from a later run(), after reset(). If the
+     *  io_service is destroyed before libzmq releases the last part, the
+     *  handler is destroyed without being called.
      */
     template<typename ConstBufferSequence,
              typename WriteHandler>
-    void async_send(ConstBufferSequence const& buffers,
-                    WriteHandler && handler,
-                    flags_type flags = 0) {
-        using type = detail::send_buffer_op<ConstBufferSequence, WriteHandler>;
-        get_service().enqueue<type>(get_implementation(), detail::socket_service::op_type::write_op,
-                                    buffers, std::forward<WriteHandler>(handler), flags);
+    AZMQ_INITFN_RESULT_TYPE(WriteHandler, void(boost::system::error_code, size_t))
+    async_send(nocopy_t,
+               ConstBufferSequence const& buffers,
+               WriteHandler && handler,
+               flags_type flags = 0) {
+        return detail::initiate_async<WriteHandler, void(boost::system::error_code, size_t)>(
+                initiate<detail::send_nocopy_op, ConstBufferSequence>(detail::socket_service::op_type::write_op),
+                handler, get_service().shutdown_flag(), std::ref(get_io_service()),
+                detail::socket_service::get_strand(get_implementation()), buffers, flags);
+    }
+
+    /** \brief Initiate an async send of a buffer sequence as a single message part
+     *  \tparam ConstBufferSequence must conform to the asio
+     *          ConstBufferSequence concept
+     *  \tparam WriteHandler must conform to the asio
+     *          WriteHandler concept
+     *  \param buffers ConstBufferSequence to concatenate
+     *  \param handler WriteHandler
+     *  \param flags specifying how the send call is to be made
+     *  \remark
+     *  The buffers are gathered into one message, allocated once for the
+     *  total size, before this returns, so they need not outlive the call.
+     */
+    template<typename ConstBufferSequence,
+             typename WriteHandler>
+    AZMQ_INITFN_RESULT_TYPE(WriteHandler, void(boost::system::error_code, size_t))
+    async_send(gather_t,
+               ConstBufferSequence const& buffers,
+               WriteHandler && handler,
+               flags_type flags = 0) {
+        return detail::initiate_async<WriteHandler, void(boost::system::error_code, size_t)>(
+                initiate<detail::send_op>(detail::socket_service::op_type::write_op),
+                handler, message(gather, buffers), flags);
     }
 
     /** \brief Initate an async send operation
@@ -593,12 +932,13 @@ public:
      *  \param flags int flags
      */
     template<typename WriteHandler>
-    void async_send(message const& msg,
-                    WriteHandler && handler,
-                    flags_type flags = 0) {
-        using type = detail::send_op<WriteHandler>;
-        get_service().enqueue<type>(get_implementation(), detail::socket_service::op_type::write_op,
-                                    msg, std::forward<WriteHandler>(handler), flags);
+    AZMQ_INITFN_RESULT_TYPE(WriteHandler, void(boost::system::error_code, size_t))
+    async_send(message const& msg,
+               WriteHandler && handler,
+               flags_type flags = 0) {
+        return detail::initiate_async<WriteHandler, void(boost::system::error_code, size_t)>(
+                initiate<detail::send_op>(detail::socket_service::op_type::write_op),
+                handler, msg, flags);
     }
 
     /** \brief Initiate shutdown of socket
@@ -676,11 +1016,25 @@ public:
         return res;
     }
 
+    /** \brief snapshot of this socket's counters
+     *  \remark Does not take the socket's lock, so it may be called from any
+     *  thread, including while async operations are in progress.
+     */
+    socket_stats stats() const {
+        return detail::socket_service::stats(get_implementation());
+    }
+
     friend std::ostream& operator<<(std::ostream& stm, const socket& that) {
         auto& s = const_cast<socket&>(that);
         s.get_service().format(s.get_implementation(), stm);
         return stm;
     }
+
+private:
+    template<template<typename...> class Op, typename... Params>
+    detail::socket_service::initiate_enqueue<Op, Params...> initiate(detail::socket_service::op_type o) {
+        return detail::socket_service::initiate_enqueue<Op, Params...>{ get_service(), get_implementation(), o };
+    }
 };
 AZMQ_V1_INLINE_NAMESPACE_END
 
@@ -699,6 +1053,10 @@ namespace detail {
             static_assert(sizeof(*this) == sizeof(socket), "Specialized socket must not have any specific data members");
         }
 
+        specialized_socket(boost::asio::io_service::strand & strand)
+            : Base(strand, Type)
+        { }
+
         specialized_socket(specialized_socket&& op)
             : Base(std::move(op))
         {}
@@ -827,6 +1185,178 @@ void attach(socket & s, Range r, bool serverish = true) {
     if (attach(s, std::begin(r), std::end(r), ec, serverish))
         throw boost::system::system_error(ec);
 }
+
+/** \brief outcome of a multicast_send to a range of sockets */
+struct multicast_result {
+    /** \brief one entry per socket, in range order */
+    std::vector<boost::system::error_code> errors;
+
+    /** \brief number of sockets the message was queued on */
+    size_t sent() const {
+        return std::count(std::begin(errors), std::end(errors), boost::system::error_code());
+    }
+
+    /** \brief number of sockets which refused the message at their high water mark */
+    size_t dropped() const {
+        return std::count_if(std::begin(errors), std::end(errors), [](boost::system::error_code const& ec) {
+            return ec.value() == boost::system::errc::resource_unavailable_try_again;
+        });
+    }
+};
+
+namespace detail {
+    inline socket & as_socket(socket & s) { return s; }
+    inline socket & as_socket(socket * s) { return *s; }
+
+    template<typename Handler>
+    struct multicast_state {
+        Handler handler_;
+        multicast_result result_;
+        std::atomic<size_t> pending_;
+
+        multicast_state(Handler handler, size_t ct)
+            : handler_(std::move(handler))
+            , pending_(ct)
+        {
+            result_.errors.resize(ct);
+        }
+    };
+
+    template<typename Handler>
+    struct multicast_send_handler {
+        std::shared_ptr<multicast_state<Handler>> state_;
+        size_t index_;
+
+        void operator()(boost::system::error_code const& ec, size_t) const {
+            // each socket owns its own slot, the last to complete sees them all
+            state_->result_.errors[index_] = ec;
+            if (state_->pending_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+            auto& result = state_->result_;
+            auto it = std::find_if(std::begin(result.errors), std::end(result.errors),
+                                   [](boost::system::error_code const& e) { return !!e; });
+            auto first = it == std::end(result.errors) ? boost::system::error_code() : *it;
+            detail::invoke_handler(state_->handler_, first, result);
+        }
+    };
+
+    struct initiate_multicast_send {
+        // where an empty range completes, only null when the range is known
+        // not to be empty
+        boost::asio::io_service * ios_;
+
+        template<typename Handler, typename SocketRange>
+        void operator()(Handler && handler,
+                        std::reference_wrapper<SocketRange> sockets,
+                        message const& msg,
+                        socket::flags_type flags) const {
+            using handler_type = typename std::decay<Handler>::type;
+            auto& r = sockets.get();
+            auto ct = static_cast<size_t>(std::distance(std::begin(r), std::end(r)));
+            if (!ct) {
+                // nothing was sent and nothing failed
+                BOOST_ASSERT_MSG(ios_, "no sockets to send on");
+                detail::bound_handler<handler_type, boost::system::error_code, multicast_result>
+                    f(std::forward<Handler>(handler), boost::system::error_code(), multicast_result());
+#if BOOST_VERSION >= 106600
+                boost::asio::post(*ios_, std::move(f));
+#else
+                ios_->post(std::move(f));
+#endif
+                return;
+            }
+            auto state = std::make_shared<multicast_state<handler_type>>(std::forward<Handler>(handler), ct);
+            size_t i = 0;
+            for (auto&& s : r)
+                as_socket(s).async_send(msg, multicast_send_handler<handler_type>{ state, i++ }, flags);
+        }
+    };
+} // namespace detail
+
+/** \brief send one message on each of a range of sockets
+ *  \tparam SocketRange a range of socket& or socket*
+ *  \param sockets SocketRange to send on
+ *  \param msg message to send
+ *  \param flags specifying how each send call is to be made
+ *  \return multicast_result with the outcome for each socket
+ *  \remarks
+ *  The payload is shared between all of the sends, each socket is handed a
+ *  reference counted copy of msg rather than a copy of its data, and msg
+ *  itself is left intact. Sends never block, a socket at its high water mark
+ *  reports resource_unavailable_try_again and the remaining sockets are still
+ *  sent to. Note that PUB sockets silently drop at their high water mark, as
+ *  they do for any send. Each socket is locked only for its own send, which
+ *  is a no-op for single threaded and strand serialized sockets.
+ */
+template<typename SocketRange>
+multicast_result multicast_send(SocketRange & sockets,
+                                message const& msg,
+                                socket::flags_type flags = 0) {
+    multicast_result res;
+    res.errors.reserve(std::distance(std::begin(sockets), std::end(sockets)));
+    for (auto&& s : sockets) {
+        boost::system::error_code ec;
+        detail::as_socket(s).send(message(msg), flags | ZMQ_DONTWAIT, ec);
+        res.errors.push_back(ec);
+    }
+    return res;
+}
+
+/** \brief initiate an async send of one message on each of a range of sockets
+ *  \tparam SocketRange a range of socket& or socket*
+ *  \tparam MulticastHandler must conform to the MulticastHandler concept
+ *  \param sockets SocketRange to send on
+ *  \param msg message to send
+ *  \param handler MulticastHandler
+ *  \param flags specifying how each send call is to be made
+ *  \remarks
+ *  The MulticastHandler concept has the following interface
+ *  struct MulticastHandler {
+ *      void operator()(const boost::system::error_code & ec,
+ *                      multicast_result & result);
+ *  }
+ *  \remarks
+ *  As for multicast_send() the payload is shared rather than copied for each
+ *  socket. Unlike it, a socket at its high water mark is waited on rather than
+ *  skipped. The handler is called once, after every send has completed, from
+ *  the completion of whichever send finishes last; ec is the first error in
+ *  range order, if any.
+ *  \throw boost::system::system_error with errc::invalid_argument, before
+ *  anything is sent, if sockets is empty, as there is no io_service for the
+ *  handler to complete on. Use the overload taking an io_service for ranges
+ *  which may be empty.
+ */
+template<typename SocketRange,
+         typename MulticastHandler>
+AZMQ_INITFN_RESULT_TYPE(MulticastHandler, void(boost::system::error_code, multicast_result &))
+async_multicast_send(SocketRange & sockets,
+                     message const& msg,
+                     MulticastHandler && handler,
+                     socket::flags_type flags = 0) {
+    if (std::begin(sockets) == std::end(sockets))
+        throw boost::system::system_error(boost::system::errc::make_error_code(boost::system::errc::invalid_argument));
+    return detail::initiate_async<MulticastHandler, void(boost::system::error_code, multicast_result &)>(
+            detail::initiate_multicast_send{ nullptr }, handler, std::ref(sockets), msg, flags);
+}
+
+/** \brief initiate an async send of one message on each of a range of sockets
+ *  which may be empty
+ *  \param ios io_service the handler is posted to if sockets is empty, with no
+ *  error and an empty result
+ *  \remarks
+ *  Otherwise as async_multicast_send() above.
+ */
+template<typename SocketRange,
+         typename MulticastHandler>
+AZMQ_INITFN_RESULT_TYPE(MulticastHandler, void(boost::system::error_code, multicast_result &))
+async_multicast_send(boost::asio::io_service & ios,
+                     SocketRange & sockets,
+                     message const& msg,
+                     MulticastHandler && handler,
+                     socket::flags_type flags = 0) {
+    return detail::initiate_async<MulticastHandler, void(boost::system::error_code, multicast_result &)>(
+            detail::initiate_multicast_send{ &ios }, handler, std::ref(sockets), msg, flags);
+}
 AZMQ_V1_INLINE_NAMESPACE_END
 } // namespace azmq
 #endif // AZMQ_SOCKET_HPP_
@@ -7,13 +7,28 @@
     file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
 */
 #include <azmq/message.hpp>
+#include <azmq/message_pool.hpp>
+#include <azmq/frame_ring.hpp>
+#include <azmq/message_arena.hpp>
+#include <azmq/payload_pool.hpp>
+#include <azmq/mapped_file.hpp>
+#include <azmq/message_view.hpp>
 
 #include <boost/asio/buffer.hpp>
 
 #include <string>
 #include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
 #include <array>
 #include <iterator>
+#include <type_traits>
+#include <cstdio>
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#endif
 
 #define CATCH_CONFIG_MAIN
 #include "../catch.hpp"
@@ -97,6 +112,19 @@ TEST_CASE( "deleter", "[message]" ) {
     }
     REQUIRE(3 == global_ctr);
 
+    {
+        // small enough to be held in the hint rather than allocated
+        int released = 0;
+        {
+            azmq::message m9(azmq::nocopy, boost::asio::buffer(global_buf), [&released](void *buf){
+                REQUIRE(buf == global_buf);
+                ++released;
+            });
+            azmq::message m10(m9);
+        }
+        REQUIRE(1 == released);
+    }
+
     {
         azmq::message m5(azmq::nocopy, boost::asio::buffer(global_buf), &global_hint, free_fn2);
         REQUIRE(sizeof(global_buf) == m5.size());
@@ -161,6 +189,32 @@ TEST_CASE( "message_move_operations", "[message]" ) {
     REQUIRE(mmm.size() == 42);
 }
 
+TEST_CASE( "message_inline_and_zmq_assignment", "[message]" ) {
+    std::string small(azmq::message::max_inline_size, 's');
+    std::string large(azmq::message::max_inline_size + 1, 'L');
+
+    azmq::message m(boost::asio::buffer(small));
+    azmq::message mm(boost::asio::buffer(large));
+
+    // inline <- zmq, zmq <- inline, via copy and move
+    azmq::message t(m);
+    t = mm;
+    REQUIRE(t.string() == large);
+    t = m;
+    REQUIRE(t.string() == small);
+    t = std::move(mm);
+    REQUIRE(t.string() == large);
+    REQUIRE(mm.size() == 0);
+    mm = std::move(m);
+    REQUIRE(mm.string() == small);
+    REQUIRE(m.size() == 0);
+
+    t = t;
+    REQUIRE(t.string() == large);
+    REQUIRE(t == azmq::message(boost::asio::buffer(large)));
+    REQUIRE(t != mm);
+}
+
 TEST_CASE( "write_through_mutable_buffer", "[message]" ) {
     azmq::message m("This is a test");
 
@@ -176,6 +230,21 @@ TEST_CASE( "write_through_mutable_buffer", "[message]" ) {
     REQUIRE(s != ss);
 }
 
+TEST_CASE( "write_through_shared_mutable_buffer", "[message]" ) {
+    // large enough to be reference counted rather than held inline
+    std::string str(1024, 'T');
+    azmq::message m(boost::asio::buffer(str));
+
+    azmq::message mm(m);
+    REQUIRE(mm.data() == m.data());
+    boost::asio::mutable_buffer bb = mm.buffer();
+    REQUIRE(boost::asio::buffer_cast<void const*>(bb) != m.data());
+    boost::asio::buffer_cast<char*>(bb)[0] = 't';
+
+    REQUIRE(mm.string() == "t" + str.substr(1));
+    REQUIRE(m.string() == str);
+}
+
 TEST_CASE( "comparison", "[message]" ) {
     using boost::asio::buffer;
 
@@ -232,3 +301,390 @@ TEST_CASE( "message_sequence", "[message]" ) {
         REQUIRE(azmq::message(buf) == *it++);
     }
 }
+
+TEST_CASE( "message_gather", "[message]" ) {
+    std::string foo("foo");
+    std::string bar(1024, 'b');
+
+    std::array<boost::asio::const_buffer, 2> small {{
+        boost::asio::buffer(foo),
+        boost::asio::buffer(foo)
+    }};
+    azmq::message m(azmq::gather, small);
+    REQUIRE(m.string() == foo + foo);
+
+    std::array<boost::asio::const_buffer, 3> large {{
+        boost::asio::buffer(foo),
+        boost::asio::buffer(bar),
+        boost::asio::buffer(foo)
+    }};
+    azmq::message mm(azmq::gather, large);
+    REQUIRE(mm.string() == foo + bar + foo);
+
+    std::vector<boost::asio::const_buffer> none;
+    REQUIRE(azmq::message(azmq::gather, none).size() == 0);
+}
+
+TEST_CASE( "frame_ring", "[message]" ) {
+    std::array<char, 64> region;
+    azmq::frame_ring ring(boost::asio::buffer(region));
+    REQUIRE(ring.capacity() == 64);
+    REQUIRE(ring.empty());
+
+    auto str = [](boost::asio::const_buffer const& b) {
+        return std::string(boost::asio::buffer_cast<char const*>(b), boost::asio::buffer_size(b));
+    };
+
+    // each 10 byte frame takes 24 bytes
+    REQUIRE(ring.push(boost::asio::buffer("frame-A-10", 10), true));
+    REQUIRE(ring.push(boost::asio::buffer("frame-B-10", 10)));
+    REQUIRE_FALSE(ring.push(boost::asio::buffer("frame-C-10", 10)));
+    REQUIRE(ring.frames() == 2);
+
+    REQUIRE(str(ring.front()) == "frame-A-10");
+    REQUIRE(ring.front_more());
+    ring.pop_front();
+
+    // wraps to the space freed at the start
+    REQUIRE(ring.push(boost::asio::buffer("frame-C-10", 10)));
+    REQUIRE_FALSE(ring.push(boost::asio::buffer("", 0)));
+
+    std::vector<std::string> seen;
+    REQUIRE(ring.consume([&](boost::asio::const_buffer const& b, bool more) {
+        REQUIRE_FALSE(more);
+        seen.push_back(str(b));
+    }) == 2);
+    REQUIRE(seen == std::vector<std::string>({ "frame-B-10", "frame-C-10" }));
+    REQUIRE(ring.empty());
+
+    // empty frames, and the largest frame which fits
+    REQUIRE(ring.push(boost::asio::buffer("", 0)));
+    REQUIRE(boost::asio::buffer_size(ring.front()) == 0);
+    ring.pop_front();
+    std::string big(ring.max_frame_size(), 'x');
+    REQUIRE(ring.push(boost::asio::buffer(big)));
+    REQUIRE(str(ring.front()) == big);
+    ring.pop_front();
+    big.push_back('x');
+    REQUIRE_FALSE(ring.push(boost::asio::buffer(big)));
+
+    // frame sizes are held in 32 bits, however large the region, which is
+    // never touched here
+    if (sizeof(size_t) > 4) {
+        azmq::frame_ring huge(boost::asio::buffer(region.data(), size_t(0xffffffff) * 2));
+        REQUIRE(huge.max_frame_size() == 0xfffffffe);
+    }
+}
+
+TEST_CASE( "message_arena", "[message]" ) {
+    azmq::message_arena arena(1024);
+    std::string payload(100, 'p');
+
+    auto m = arena.allocate(boost::asio::buffer(payload));
+    REQUIRE(m.string() == payload);
+    auto mm = arena.allocate(boost::asio::buffer(payload));
+    REQUIRE(mm.string() == payload);
+    // bump allocated from the same chunk
+    auto gap = static_cast<char const*>(mm.data()) - static_cast<char const*>(m.data());
+    REQUIRE(gap == 112);
+    REQUIRE(arena.chunks_created() == 1);
+
+    // small messages are inline, large ones allocated by libzmq
+    REQUIRE(arena.allocate(azmq::message::max_inline_size).size() == azmq::message::max_inline_size);
+    REQUIRE(arena.allocate(2048).size() == 2048);
+    REQUIRE(arena.chunks_created() == 1);
+
+    // a retired chunk is reused only once its messages are released
+    auto first = m.data();
+    arena.reset();
+    auto n = arena.allocate(boost::asio::buffer(payload));
+    REQUIRE(arena.chunks_created() == 2);
+    arena.reset();
+    n = azmq::message();
+    m = azmq::message();
+    mm = azmq::message();
+    n = arena.allocate(boost::asio::buffer(payload));
+    REQUIRE(arena.chunks_created() == 2);
+    REQUIRE(n.data() == first);
+
+    // filling a chunk moves on to the next
+    for (auto i = 0; i != 20; ++i)
+        arena.allocate(boost::asio::buffer(payload));
+    REQUIRE(arena.chunks_created() == 2);
+
+    // messages may outlive their arena
+    azmq::message kept;
+    {
+        azmq::message_arena a(256);
+        kept = a.allocate(boost::asio::buffer(payload));
+    }
+    REQUIRE(kept.string() == payload);
+
+    REQUIRE(&azmq::message_arena::local() == &azmq::message_arena::local());
+}
+
+TEST_CASE( "message_pool", "[message]" ) {
+    auto pool = azmq::message_pool::create(1);
+    REQUIRE(pool->free_count() == 0);
+
+    auto m = pool->lease();
+    REQUIRE(m);
+    REQUIRE(m.use_count() == 1);
+    REQUIRE(m->size() == 0);
+    *m = azmq::message("bla-bla");
+    auto p = m->data();
+
+    {
+        auto mm = m;
+        REQUIRE(m.use_count() == 2);
+        REQUIRE(mm->data() == p);
+    }
+    REQUIRE(m.use_count() == 1);
+
+    auto n = pool->lease();
+    m.reset();
+    REQUIRE_FALSE(m);
+    REQUIRE(pool->free_count() == 1);
+
+    // returned messages are emptied, and reused before new ones are made
+    auto mm = pool->lease();
+    REQUIRE(pool->free_count() == 0);
+    REQUIRE(mm->size() == 0);
+
+    // beyond max_free released messages are freed
+    mm.reset();
+    n.reset();
+    REQUIRE(pool->free_count() == 1);
+
+    // leases keep the pool alive, though not its shared_ptr
+    std::weak_ptr<azmq::message_pool> wp = pool;
+    mm = pool->lease();
+    pool.reset();
+    REQUIRE(wp.expired());
+    *mm = azmq::message("bla-bla");
+    REQUIRE(mm->string() == "bla-bla");
+    mm.reset();
+}
+
+TEST_CASE( "payload_pool", "[message]" ) {
+    auto node = azmq::payload_pool::current_node();
+    azmq::payload_pool pool(64 * 1024, 2);
+    std::string payload(1000, 'p');
+
+    auto m = pool.allocate(boost::asio::buffer(payload));
+    REQUIRE(m.string() == payload);
+    REQUIRE(pool.blocks_mapped() == 1);
+    auto first = m.data();
+
+    // released blocks are reused
+    m = azmq::message();
+    REQUIRE(pool.free_count(node) == 1);
+    m = pool.allocate(64 * 1024);
+    REQUIRE(m.data() == first);
+    REQUIRE(m.size() == 64 * 1024);
+    REQUIRE(pool.blocks_mapped() == 1);
+
+    // small and oversized requests are not taken from the pool
+    REQUIRE(pool.allocate(8).size() == 8);
+    REQUIRE(pool.allocate(64 * 1024 + 1).size() == 64 * 1024 + 1);
+    REQUIRE(pool.blocks_mapped() == 1);
+
+    // no more than max_free blocks are retained
+    pool.reserve(3);
+    REQUIRE(pool.blocks_mapped() == 4);
+    REQUIRE(pool.free_count(node) == 2);
+
+    // messages may outlive their pool
+    azmq::message kept;
+    {
+        azmq::payload_pool p(64 * 1024, 2, 0);
+        kept = p.allocate(boost::asio::buffer(payload));
+        REQUIRE(p.huge_page_blocks() == 0);
+    }
+    REQUIRE(kept.string() == payload);
+}
+
+#ifdef AZMQ_HAS_MAPPED_FILE
+TEST_CASE( "mapped_file", "[message]" ) {
+    const std::string path("azmq_test_mapped_file.bin");
+    std::string payload("0123456789");
+    {
+        auto f = azmq::mapped_file::create(path, payload.size());
+        REQUIRE(f.writable());
+        boost::asio::buffer_copy(f.buffer(), boost::asio::buffer(payload));
+        f.flush();
+    }
+
+    azmq::message frame;
+    {
+        azmq::mapped_file f(path);
+        REQUIRE_FALSE(f.writable());
+        REQUIRE(f.size() == payload.size());
+
+        auto frames = f.frames(4);
+        REQUIRE(frames.size() == 3);
+        REQUIRE(frames[0].string() == "0123");
+        REQUIRE(frames[2].string() == "89");
+        REQUIRE(frames[1].data() == static_cast<char const*>(f.data()) + 4);
+        REQUIRE(f.use_count() == 4);
+
+        // a region at an unaligned offset
+        azmq::mapped_file g(path, 3, 5);
+        REQUIRE(g.frame(0, g.size()).string() == "34567");
+
+        frame = frames[1];
+    }
+    // frames keep the mapping alive
+    REQUIRE(frame.string() == "4567");
+    std::remove(path.c_str());
+
+    REQUIRE_THROWS_AS(azmq::mapped_file("azmq_test_no_such_file.bin"), boost::system::system_error const&);
+}
+#endif
+
+namespace view_test {
+    enum class kind : uint8_t { request = 1, reply = 2 };
+
+    using type = azmq::field<kind, 0>;
+    using length = azmq::field<uint32_t, 1, azmq::byte_order::big>;
+    using seq = azmq::field<uint64_t, 5>;
+    using ratio = azmq::field<double, 13, azmq::byte_order::big>;
+    using tag = azmq::bytes_field<21, 3>;
+    using header = azmq::layout<24, type, length, seq, ratio, tag>;
+
+    using id = azmq::field<uint16_t, 0>;
+    using envelope = azmq::layout<2, id>;
+}
+
+TEST_CASE( "message_view", "[message]" ) {
+    using namespace view_test;
+
+    azmq::message m(header::size + 4);
+    azmq::mutable_message_view<header> w(m);
+    w.set<type>(kind::reply);
+    w.set<length>(0x01020304);
+    w.set<seq>(42);
+    w.set<ratio>(0.5);
+    boost::asio::buffer_copy(w.mutable_bytes<tag>(), boost::asio::buffer("abc", 3));
+    boost::asio::buffer_copy(boost::asio::buffer(m.buffer() + header::size), boost::asio::buffer("body", 4));
+
+    // stored in the declared byte order, at unaligned offsets
+    auto p = static_cast<unsigned char const*>(m.data());
+    REQUIRE(p[1] == 0x01);
+    REQUIRE(p[4] == 0x04);
+    REQUIRE(p[5] == 42);
+
+    azmq::message_view<header> v(m);
+    REQUIRE(v.get<type>() == kind::reply);
+    REQUIRE(v.get<length>() == 0x01020304);
+    REQUIRE(v.get<seq>() == 42);
+    REQUIRE(v.get<ratio>() == 0.5);
+    REQUIRE(azmq::message(v.bytes<tag>()).string() == "abc");
+    REQUIRE(azmq::message(v.tail()).string() == "body");
+
+    // size is validated once, on construction
+    boost::system::error_code ec;
+    azmq::message short_msg(header::size - 1);
+    azmq::message_view<header> bad(short_msg, ec);
+    REQUIRE(ec == boost::system::errc::message_size);
+    REQUIRE_FALSE(bad);
+    REQUIRE_THROWS_AS(azmq::message_view<header>{ short_msg }, boost::system::system_error const&);
+
+    // a view of a temporary message would dangle
+    static_assert(!std::is_constructible<azmq::message_view<header>, azmq::message>::value, "view of an rvalue");
+    static_assert(!std::is_constructible<azmq::message_view<header>, azmq::message, boost::system::error_code &>::value,
+                  "view of an rvalue");
+    static_assert(!std::is_constructible<azmq::mutable_message_view<header>, azmq::message>::value, "view of an rvalue");
+    static_assert(!std::is_constructible<azmq::mutable_message_view<header>, azmq::message, boost::system::error_code &>::value,
+                  "view of an rvalue");
+
+    azmq::message_vector parts;
+    parts.emplace_back(boost::asio::buffer("\x07\x00", 2));
+    parts.push_back(m);
+    azmq::multipart_view<envelope, header> mv(parts, ec);
+    REQUIRE(!ec);
+    REQUIRE(mv.part<0>().get<id>() == 7);
+    REQUIRE(mv.part<1>().get<seq>() == 42);
+
+    parts.pop_back();
+    azmq::multipart_view<envelope, header> short_mv(parts, ec);
+    REQUIRE(ec == boost::system::errc::message_size);
+}
+
+TEST_CASE( "small message benchmark", "[.][perf]" ) {
+    const size_t ct = 10000000;
+    std::string payload(256, 'x');
+    for (size_t size = 8; size <= payload.size(); size *= 2) {
+        auto buf = boost::asio::buffer(payload.data(), size);
+        auto time = [&](char const* what, std::function<void()> const& f) {
+            auto start = std::chrono::steady_clock::now();
+            for (auto i = 0u; i != ct; ++i)
+                f();
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            std::cout << size << " bytes " << what << ": " << double(ns) / ct << "ns" << std::endl;
+        };
+
+        azmq::message m(buf);
+        azmq::message mm(buf);
+        size_t sink = 0;
+        time("construct", [&] { azmq::message t(buf); sink += t.size(); });
+        time("copy", [&] { azmq::message t(m); sink += t.size(); });
+        time("compare", [&] { sink += (m == mm); });
+        REQUIRE(sink);
+    }
+}
+
+TEST_CASE( "gather benchmark", "[.][perf]" ) {
+    const size_t ct = 1000000;
+    std::vector<std::string> frags(16, std::string(64, 'f'));
+    std::vector<boost::asio::const_buffer> bufs;
+    for (auto& f : frags)
+        bufs.push_back(boost::asio::buffer(f));
+
+    auto time = [&](char const* what, std::function<size_t()> const& f) {
+        size_t sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (auto i = 0u; i != ct; ++i)
+            sink += f();
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        std::cout << bufs.size() << " x 64 bytes " << what << ": " << double(ns) / ct << "ns" << std::endl;
+        REQUIRE(sink);
+    };
+
+    time("string concat", [&] {
+        std::string s;
+        for (auto& b : bufs)
+            s.append(boost::asio::buffer_cast<char const*>(b), boost::asio::buffer_size(b));
+        return azmq::message(boost::string_ref(s)).size();
+    });
+    time("gather", [&] { return azmq::message(azmq::gather, bufs).size(); });
+}
+
+#if defined(__linux__)
+TEST_CASE( "payload pool benchmark", "[.][perf]" ) {
+    const size_t ct = 200;
+    const size_t size = 3 * 1024 * 1024;
+    azmq::payload_pool pool(4 * 1024 * 1024);
+    pool.reserve(2);
+    std::cout << "huge page blocks: " << pool.huge_page_blocks() << std::endl;
+
+    auto time = [&](char const* what, std::function<azmq::message()> const& f) {
+        rusage before;
+        getrusage(RUSAGE_SELF, &before);
+        auto start = std::chrono::steady_clock::now();
+        for (auto i = 0u; i != ct; ++i) {
+            auto m = f();
+            std::fill_n(boost::asio::buffer_cast<char*>(m.buffer()), m.size(), char(i));
+        }
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        rusage after;
+        getrusage(RUSAGE_SELF, &after);
+        std::cout << what << ": " << double(ns) / ct / 1000 << "us, "
+                  << double(size) * ct / ns << "GB/s, "
+                  << double(after.ru_minflt - before.ru_minflt) / ct << " minor faults per message" << std::endl;
+    };
+
+    time("message(size)", [&] { return azmq::message(size); });
+    time("payload_pool", [&] { return pool.allocate(size); });
+}
+#endif
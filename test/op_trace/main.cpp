@@ -0,0 +1,117 @@
+/*
+    Copyright (c) 2013-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of azmq
+
+    Distributed under the Boost Software License, Version 1.0. (See accompanying
+    file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#define AZMQ_ENABLE_OP_TRACING 1
+#include <azmq/socket.hpp>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/buffer.hpp>
+
+#include <functional>
+#include <string>
+#include <thread>
+
+#define CATCH_CONFIG_MAIN
+#include "../catch.hpp"
+
+std::string subj(const char* name) {
+    return std::string("inproc://") + name;
+}
+
+TEST_CASE( "latency_histogram", "[op_trace]" ) {
+    using dist = azmq::detail::latency_distribution;
+
+    // every value maps to a bucket whose range contains it
+    for (uint64_t v : { 0ull, 1ull, 7ull, 8ull, 9ull, 15ull, 16ull, 17ull, 1000ull, 123456789ull, ~0ull }) {
+        auto i = dist::bucket_index(v);
+        REQUIRE(i < dist::bucket_count);
+        REQUIRE(dist::highest_equivalent(i) >= v);
+        if (i)
+            REQUIRE(dist::highest_equivalent(i - 1) < v);
+    }
+
+    azmq::detail::latency_histogram h;
+    for (uint64_t v = 1; v <= 1000; ++v)
+        h.record(v * 1000);
+
+    dist d;
+    h.snapshot(d);
+    REQUIRE(d.count == 1000);
+    REQUIRE(d.max == 1000000);
+    REQUIRE(d.mean() == 500500.0);
+
+    // within the precision of a bucket
+    auto p50 = d.percentile(0.5);
+    REQUIRE(p50 >= 500000);
+    REQUIRE(p50 <= 500000 + 500000 / dist::sub_buckets);
+    auto p99 = d.percentile(0.99);
+    REQUIRE(p99 >= 990000);
+    REQUIRE(p99 <= 990000 + 990000 / dist::sub_buckets);
+    REQUIRE(d.percentile(1.0) == 1000000);
+}
+
+TEST_CASE( "Send/Receive async op_trace_stats", "[op_trace]" ) {
+    boost::asio::io_service ios;
+
+    azmq::socket sb(ios, ZMQ_PAIR);
+    sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+    azmq::socket sc(ios, ZMQ_PAIR);
+    sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+    const size_t ct = 100;
+    size_t sent = 0;
+    size_t received = 0;
+
+    std::function<void()> send = [&] {
+        sc.async_send(boost::asio::buffer(&sent, sizeof(sent)), [&](boost::system::error_code const& ec, size_t) {
+            if (!ec && ++sent < ct)
+                send();
+        });
+    };
+
+    size_t value = 0;
+    std::function<void()> receive = [&] {
+        sb.async_receive(boost::asio::buffer(&value, sizeof(value)), [&](boost::system::error_code const& ec, size_t) {
+            if (!ec && ++received < ct)
+                receive();
+        });
+    };
+
+    receive();
+    send();
+    ios.run();
+    REQUIRE(received == ct);
+
+    azmq::socket::op_trace_stats stats;
+    sb.get_option(stats);
+    auto const& s = stats.value();
+    REQUIRE(s.queue_wait.count == ct);
+    REQUIRE(s.completion.count == ct);
+    REQUIRE(s.queue_wait.percentile(0.5) <= s.queue_wait.max);
+    REQUIRE(s.speculative_hits <= s.speculative_attempts);
+
+    sc.get_option(stats);
+    REQUIRE(stats.value().completion.count == ct);
+    // sends never have to wait on a PAIR socket with room in its pipe
+    REQUIRE(stats.value().speculative_attempts > 0);
+    REQUIRE(stats.value().speculative_hit_rate() == 1.0);
+
+    // cancelled ops were never performed and are not counted
+    sb.async_receive(boost::asio::buffer(&value, sizeof(value)), [](boost::system::error_code const&, size_t) { });
+    sb.cancel();
+    ios.reset();
+    ios.run();
+    sb.get_option(stats);
+    REQUIRE(stats.value().queue_wait.count == ct);
+    REQUIRE(stats.value().completion.count == ct);
+
+    boost::system::error_code ec;
+    sb.set_option(stats, ec);
+    REQUIRE(ec == boost::system::errc::invalid_argument);
+}
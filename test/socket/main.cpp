@@ -7,21 +7,45 @@
     file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
 */
 #include <azmq/socket.hpp>
+#include <azmq/mapped_file.hpp>
+#include <azmq/message_arena.hpp>
 #include <azmq/util/scope_guard.hpp>
 
 #include <boost/utility/string_ref.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/asio/buffer.hpp>
+#include <boost/asio/use_future.hpp>
+#if BOOST_VERSION >= 106600
+#include <boost/asio/bind_executor.hpp>
+#endif
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#endif
 
 #include <array>
 #include <thread>
 #include <iostream>
 #include <string>
+#include <sstream>
 #include <vector>
 #include <cstdint>
 #include <memory>
 #include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <new>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#endif
 
 #define CATCH_CONFIG_MAIN
 #include "../catch.hpp"
@@ -35,6 +59,40 @@ std::string subj(const char* name) {
     return std::string("inproc://") + name;
 }
 
+// counts global allocations while allocation_counting is set
+std::atomic<bool> allocation_counting(false);
+std::atomic<size_t> allocation_count(0);
+
+void* operator new(size_t size) {
+    if (allocation_counting)
+        ++allocation_count;
+    if (auto p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) BOOST_NOEXCEPT {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) BOOST_NOEXCEPT {
+    std::free(p);
+}
+
+#if defined(__GLIBC__)
+// counts malloc calls, including those made by libzmq and by operator new above,
+// while allocation_counting is set
+std::atomic<size_t> malloc_count(0);
+
+extern "C" void* __libc_malloc(size_t size);
+
+extern "C" void* malloc(size_t size) BOOST_NOEXCEPT {
+    if (allocation_counting)
+        ++malloc_count;
+    return __libc_malloc(size);
+}
+#endif
+
 TEST_CASE( "Set/Get options", "[socket]" ) {
     boost::asio::io_service ios;
 
@@ -54,6 +112,19 @@ TEST_CASE( "Set/Get options", "[socket]" ) {
     azmq::socket::allow_speculative out_speculative;
     s.get_option(out_speculative);
     REQUIRE(in_speculative.value() == out_speculative.value());
+
+    azmq::socket::speculative_window out_window;
+    s.get_option(out_window);
+    REQUIRE(out_window.value() == 1);
+
+    azmq::socket::speculative_window in_window(8);
+    s.set_option(in_window);
+    s.get_option(out_window);
+    REQUIRE(in_window.value() == out_window.value());
+
+    boost::system::error_code ec;
+    s.set_option(azmq::socket::speculative_window(0), ec);
+    REQUIRE(ec == boost::system::errc::invalid_argument);
 }
 
 TEST_CASE( "Send/Receive single buffer", "[socket]") {
@@ -76,6 +147,34 @@ TEST_CASE( "Send/Receive single buffer", "[socket]") {
     REQUIRE(boost::string_ref(msg) == boost::string_ref(buf.data()));
 }
 
+TEST_CASE( "Send const inline message", "[socket]" ) {
+    boost::asio::io_service ios;
+
+    std::vector<azmq::socket> senders;
+    std::vector<azmq::socket> receivers;
+    for (auto i = 0; i != 2; ++i) {
+        auto ep = subj(BOOST_CURRENT_FUNCTION) + std::to_string(i);
+        receivers.emplace_back(ios, ZMQ_PAIR);
+        receivers.back().bind(ep);
+        senders.emplace_back(ios, ZMQ_PAIR);
+        senders.back().connect(ep);
+    }
+
+    // held inline, sending leaves it as it was, so several sockets may send
+    // it at once
+    const azmq::message msg(boost::asio::buffer("inline", 6));
+    std::thread t([&] { senders[0].send(msg); });
+    senders[1].send(msg);
+    t.join();
+    REQUIRE(msg.string() == "inline");
+
+    for (auto& r : receivers) {
+        azmq::message m;
+        r.receive(m);
+        REQUIRE(m.string() == "inline");
+    }
+}
+
 TEST_CASE( "Send/Receive synchronous", "[socket]" ) {
     boost::asio::io_service ios;
 
@@ -567,3 +666,1281 @@ TEST_CASE( "Loopback", "[socket]" ) {
     REQUIRE(s.ec == boost::system::error_code());
     REQUIRE(s.ct == ct);
 }
+
+TEST_CASE( "Async receive loop does not allocate", "[socket]" ) {
+    boost::asio::io_service ios;
+
+    azmq::socket sb(ios, ZMQ_PAIR, true);
+    sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+    azmq::socket sc(ios, ZMQ_PAIR, true);
+    sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+    const size_t warmup = 100;
+    const size_t ct = 1000;
+    for (auto i = 0u; i < ct; ++i)
+        sc.send(boost::asio::buffer(&i, sizeof(i)));
+
+    struct receiver {
+        azmq::socket & s_;
+        size_t ct_;
+        size_t received_;
+        size_t allocations_;
+        boost::system::error_code ec_;
+
+        void start() {
+            s_.async_receive([this](boost::system::error_code const& ec, azmq::message &, size_t) {
+                if (ec) {
+                    ec_ = ec;
+                    return;
+                }
+
+                if (++received_ == warmup)
+                    allocation_counting = true;
+
+                if (received_ == ct_) {
+                    allocation_counting = false;
+                    allocations_ = allocation_count;
+                    return;
+                }
+                start();
+            });
+        }
+    } r{ sb, ct, 0, 0, boost::system::error_code() };
+
+    allocation_count = 0;
+    r.start();
+    ios.run();
+
+    REQUIRE(r.ec_ == boost::system::error_code());
+    REQUIRE(r.received_ == ct);
+    REQUIRE(r.allocations_ == 0);
+}
+
+#if defined(__GLIBC__)
+TEST_CASE( "message_arena allocations", "[socket]" ) {
+    const size_t ct = 16;
+    azmq::message_arena arena;
+    std::string payload(1000, 'p');
+    std::vector<azmq::message> msgs;
+    msgs.reserve(ct + 1);
+    // obtains the arena's first chunk
+    msgs.push_back(arena.allocate(boost::asio::buffer(payload)));
+
+    allocation_count = 0;
+    malloc_count = 0;
+    allocation_counting = true;
+    for (size_t i = 0; i != ct; ++i)
+        msgs.push_back(arena.allocate(boost::asio::buffer(payload)));
+    allocation_counting = false;
+
+    // the payloads come from the chunk, but libzmq still mallocs the
+    // reference counted content block of each message it is handed
+    size_t news = allocation_count;
+    size_t mallocs = malloc_count;
+    REQUIRE(news == 0);
+    REQUIRE(mallocs == ct);
+    REQUIRE(arena.chunks_created() == 1);
+
+    // as many as for a message allocated by libzmq, whose payload shares the block
+    malloc_count = 0;
+    allocation_counting = true;
+    {
+        azmq::message m(payload.size());
+        allocation_counting = false;
+    }
+    mallocs = malloc_count;
+    REQUIRE(mallocs == 1);
+}
+#endif
+
+TEST_CASE( "Receive batch async", "[socket]" ) {
+    boost::asio::io_service ios;
+
+    azmq::socket sb(ios, ZMQ_PAIR);
+    sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+    azmq::socket sc(ios, ZMQ_PAIR);
+    sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+    for (auto i = 0u; i < 9; ++i)
+        sc.send(boost::asio::buffer(&i, sizeof(i)));
+    sc.send(snd_bufs);
+
+    std::vector<size_t> batches;
+    size_t parts = 0;
+    size_t btb = 0;
+    boost::system::error_code ecb;
+    std::function<void()> receive_batch = [&] {
+        sb.async_receive_batch(8, [&](boost::system::error_code const& ec,
+                                      azmq::message_vector & msgs, size_t bytes_transferred) {
+            ecb = ec;
+            if (ec)
+                return;
+            btb += bytes_transferred;
+            parts += msgs.size();
+            batches.push_back(std::count_if(std::begin(msgs), std::end(msgs),
+                                            [](azmq::message const& m) { return !m.more(); }));
+            if (parts < 11)
+                receive_batch();
+        });
+    };
+    receive_batch();
+    ios.run();
+
+    REQUIRE(ecb == boost::system::error_code());
+    REQUIRE(parts == 11);
+    REQUIRE(btb == 9 * sizeof(unsigned) + 4);
+    REQUIRE(batches.size() == 2);
+    REQUIRE(batches[0] == 8);
+    REQUIRE(batches[1] == 2);
+}
+
+TEST_CASE( "Receive continuous async", "[socket]" ) {
+    boost::asio::io_service ios;
+
+    azmq::socket sb(ios, ZMQ_PAIR, true);
+    sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+    azmq::socket sc(ios, ZMQ_PAIR, true);
+    sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+    const size_t warmup = 100;
+    const size_t ct = 1000;
+    for (auto i = 0u; i < ct; ++i)
+        sc.send(boost::asio::buffer(&i, sizeof(i)));
+
+    size_t received = 0;
+    size_t finals = 0;
+    size_t allocations = 0;
+    bool in_order = true;
+    boost::system::error_code ecb;
+    sb.async_receive_continuous([&](boost::system::error_code const& ec, azmq::message & msg, size_t bytes_transferred) {
+        if (ec) {
+            ++finals;
+            ecb = ec;
+            return;
+        }
+
+        unsigned value = 0;
+        msg.buffer_copy(boost::asio::buffer(&value, sizeof(value)));
+        in_order &= value == received && bytes_transferred == sizeof(value);
+
+        if (++received == warmup)
+            allocation_counting = true;
+
+        if (received == ct) {
+            allocation_counting = false;
+            allocations = allocation_count;
+            // picked up once the op is back on the queue
+            sc.send(boost::asio::buffer(&received, sizeof(unsigned)));
+        }
+
+        if (received == ct + 1)
+            sb.cancel();
+    });
+
+    allocation_count = 0;
+    ios.run();
+
+    REQUIRE(received == ct + 1);
+    REQUIRE(in_order);
+    REQUIRE(allocations == 0);
+    REQUIRE(finals == 1);
+    REQUIRE(ecb == boost::asio::error::operation_aborted);
+
+    // cancelled while waiting on the queue
+    size_t calls = 0;
+    sb.async_receive_continuous([&](boost::system::error_code const& ec, azmq::message &, size_t) {
+        ++calls;
+        ecb = ec;
+    });
+    sb.cancel();
+    ios.reset();
+    ios.run();
+    REQUIRE(calls == 1);
+    REQUIRE(ecb == boost::asio::error::operation_aborted);
+}
+
+TEST_CASE( "Send/Receive async strand threads", "[socket]" ) {
+    boost::asio::io_service ios;
+    boost::asio::io_service::strand strand(ios);
+
+    azmq::socket sb(strand, ZMQ_PAIR);
+    sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+    azmq::socket sc(strand, ZMQ_PAIR);
+    sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+    const size_t ct = 1000;
+    size_t sent = 0;
+    size_t received = 0;
+    bool off_strand = false;
+    boost::system::error_code ecc;
+    boost::system::error_code ecb;
+
+    std::function<void()> send = [&] {
+        sc.async_send(boost::asio::buffer(&sent, sizeof(sent)), [&](boost::system::error_code const& ec, size_t) {
+            off_strand |= !strand.running_in_this_thread();
+            ecc = ec;
+            if (!ec && ++sent < ct)
+                send();
+        });
+    };
+
+    size_t value = 0;
+    auto rcv_buf = boost::asio::buffer(&value, sizeof(value));
+    std::function<void()> receive = [&] {
+        sb.async_receive(rcv_buf, [&](boost::system::error_code const& ec, size_t) {
+            off_strand |= !strand.running_in_this_thread();
+            ecb = ec;
+            if (!ec && value == received && ++received < ct)
+                receive();
+        });
+    };
+
+#ifdef AZMQ_DETAIL_USE_IO_SERVICE
+    strand.post([&] { receive(); send(); });
+#else
+    boost::asio::post(strand, [&] { receive(); send(); });
+#endif
+
+    std::vector<std::thread> threads;
+    for (auto i = 0; i < 4; ++i)
+        threads.emplace_back([&] { ios.run(); });
+    for (auto& t : threads)
+        t.join();
+
+    REQUIRE(ecc == boost::system::error_code());
+    REQUIRE(ecb == boost::system::error_code());
+    REQUIRE(sent == ct);
+    REQUIRE(received == ct);
+    REQUIRE(off_strand == false);
+}
+
+#if BOOST_VERSION >= 106600
+TEST_CASE( "Send/Receive async bind_executor", "[socket]" ) {
+    boost::asio::io_service ios;
+    boost::asio::io_service::strand strand(ios);
+
+    azmq::socket sb(ios, ZMQ_PAIR);
+    sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+    azmq::socket sc(ios, ZMQ_PAIR);
+    sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+    const size_t ct = 1000;
+    size_t sent = 0;
+    size_t received = 0;
+    std::atomic<bool> off_strand(false);
+    boost::system::error_code ecc;
+    boost::system::error_code ecb;
+
+    std::function<void()> send = [&] {
+        sc.async_send(boost::asio::buffer(&sent, sizeof(sent)),
+            boost::asio::bind_executor(strand, [&](boost::system::error_code const& ec, size_t) {
+                off_strand = off_strand || !strand.running_in_this_thread();
+                ecc = ec;
+                if (!ec && ++sent < ct)
+                    send();
+            }));
+    };
+
+    size_t value = 0;
+    auto rcv_buf = boost::asio::buffer(&value, sizeof(value));
+    std::function<void()> receive = [&] {
+        sb.async_receive(rcv_buf,
+            boost::asio::bind_executor(strand, [&](boost::system::error_code const& ec, size_t) {
+                off_strand = off_strand || !strand.running_in_this_thread();
+                ecb = ec;
+                if (!ec && value == received && ++received < ct)
+                    receive();
+            }));
+    };
+
+    boost::asio::post(strand, [&] { receive(); send(); });
+
+    std::vector<std::thread> threads;
+    for (auto i = 0; i < 4; ++i)
+        threads.emplace_back([&] { ios.run(); });
+    for (auto& t : threads)
+        t.join();
+
+    REQUIRE(ecc == boost::system::error_code());
+    REQUIRE(ecb == boost::system::error_code());
+    REQUIRE(sent == ct);
+    REQUIRE(received == ct);
+    REQUIRE(off_strand == false);
+}
+#endif
+
+TEST_CASE( "Send/Receive async speculative window", "[socket]" ) {
+    boost::asio::io_service ios;
+
+    azmq::socket sb(ios, ZMQ_PAIR);
+    sb.set_option(azmq::socket::speculative_window(8));
+    sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+    azmq::socket sc(ios, ZMQ_PAIR);
+    sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+    const size_t ct = 8;
+    for (auto i = 0u; i < ct; ++i)
+        sc.send(boost::asio::buffer(&i, sizeof(i)));
+
+    std::array<unsigned, ct> values;
+    std::array<boost::asio::mutable_buffers_1, ct> rcv_bufs = {{
+        boost::asio::buffer(&values[0], sizeof(unsigned)),
+        boost::asio::buffer(&values[1], sizeof(unsigned)),
+        boost::asio::buffer(&values[2], sizeof(unsigned)),
+        boost::asio::buffer(&values[3], sizeof(unsigned)),
+        boost::asio::buffer(&values[4], sizeof(unsigned)),
+        boost::asio::buffer(&values[5], sizeof(unsigned)),
+        boost::asio::buffer(&values[6], sizeof(unsigned)),
+        boost::asio::buffer(&values[7], sizeof(unsigned))
+    }};
+
+    std::vector<size_t> completed;
+    for (auto i = 0u; i < ct; ++i) {
+        sb.async_receive(rcv_bufs[i], [&, i](boost::system::error_code const& ec, size_t) {
+            if (!ec) completed.push_back(i);
+        });
+    }
+
+    // every op was performed at initiation, nothing is left for the reactor
+    boost::system::error_code ec;
+    unsigned extra;
+    sb.receive(boost::asio::buffer(&extra, sizeof(extra)), ZMQ_DONTWAIT, ec);
+    REQUIRE(ec.value() == EAGAIN);
+
+    ios.run();
+
+    REQUIRE(completed.size() == ct);
+    for (auto i = 0u; i < ct; ++i) {
+        REQUIRE(completed[i] == i);
+        REQUIRE(values[i] == i);
+    }
+}
+
+#ifdef AZMQ_DETAIL_HAS_EPOLL_REACTOR
+TEST_CASE( "Send/Receive async epoll reactor", "[socket]" ) {
+    boost::asio::io_service ios;
+    azmq::set_option(ios, azmq::use_epoll_reactor(true));
+
+    boost::system::error_code ec;
+    azmq::use_epoll_reactor use_epoll;
+    azmq::get_option(ios, use_epoll, ec);
+    REQUIRE(ec == boost::system::error_code());
+    REQUIRE(use_epoll.value());
+
+    azmq::socket sb(ios, ZMQ_PAIR);
+    sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+    azmq::socket sc(ios, ZMQ_PAIR);
+    sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+    const size_t ct = 1000;
+    size_t sent = 0;
+    size_t received = 0;
+    boost::system::error_code ecc;
+    boost::system::error_code ecb;
+
+    std::function<void()> send = [&] {
+        sc.async_send(boost::asio::buffer(&sent, sizeof(sent)), [&](boost::system::error_code const& ec, size_t) {
+            ecc = ec;
+            if (!ec && ++sent < ct)
+                send();
+        });
+    };
+
+    size_t value = 0;
+    auto rcv_buf = boost::asio::buffer(&value, sizeof(value));
+    std::function<void()> receive = [&] {
+        sb.async_receive(rcv_buf, [&](boost::system::error_code const& ec, size_t) {
+            ecb = ec;
+            if (!ec && value == received && ++received < ct)
+                receive();
+        });
+    };
+
+    receive();
+    send();
+    ios.run();
+
+    REQUIRE(ecc == boost::system::error_code());
+    REQUIRE(ecb == boost::system::error_code());
+    REQUIRE(sent == ct);
+    REQUIRE(received == ct);
+
+    // an op waiting on the epoll reactor is cancelled like any other
+    sb.async_receive(rcv_buf, [&](boost::system::error_code const& ec, size_t) {
+        ecb = ec;
+    });
+    sb.cancel();
+    ios.reset();
+    ios.run();
+    REQUIRE(ecb == boost::asio::error::operation_aborted);
+}
+
+TEST_CASE( "Epoll reactor idle/hot benchmark", "[.][perf]" ) {
+    const size_t idle_ct = 10000;
+    const size_t hot_ct = 100;
+    const size_t msg_ct = 1000;
+
+    rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+
+    auto run = [&](bool use_epoll) {
+        boost::asio::io_service ios;
+        azmq::set_option(ios, azmq::use_epoll_reactor(use_epoll));
+        auto ctx = boost::asio::use_service<azmq::detail::socket_service>(ios).context();
+        zmq_ctx_set(ctx.get(), ZMQ_MAX_SOCKETS, static_cast<int>(idle_ct + 2 * hot_ct + 16));
+
+        auto name = std::string(BOOST_CURRENT_FUNCTION) + (use_epoll ? "-epoll" : "-asio");
+        std::array<char, 8> idle_buf;
+        std::vector<std::unique_ptr<azmq::socket>> idle;
+        for (auto i = 0u; i < idle_ct; ++i) {
+            idle.emplace_back(new azmq::socket(ios, ZMQ_PAIR, true));
+            idle.back()->bind(subj((name + "-idle-" + std::to_string(i)).c_str()));
+            idle.back()->async_receive(boost::asio::buffer(idle_buf), [](boost::system::error_code const&, size_t) { });
+        }
+
+        struct hot_pair {
+            azmq::socket sb_;
+            azmq::socket sc_;
+            size_t value_ = 0;
+            size_t received_ = 0;
+
+            hot_pair(boost::asio::io_service & ios) : sb_(ios, ZMQ_PAIR, true), sc_(ios, ZMQ_PAIR, true) { }
+        };
+        std::vector<std::unique_ptr<hot_pair>> hot;
+        for (auto i = 0u; i < hot_ct; ++i) {
+            hot.emplace_back(new hot_pair(ios));
+            auto ep = subj((name + "-hot-" + std::to_string(i)).c_str());
+            hot.back()->sb_.bind(ep);
+            hot.back()->sc_.connect(ep);
+        }
+
+        size_t done = 0;
+        std::function<void(hot_pair&)> receive = [&](hot_pair & p) {
+            p.sb_.async_receive(boost::asio::buffer(&p.value_, sizeof(p.value_)),
+                                [&](boost::system::error_code const& ec, size_t) {
+                if (ec) return;
+                if (++p.received_ < msg_ct)
+                    receive(p);
+                else if (++done == hot_ct)
+                    for (auto& s : idle) s->cancel();
+            });
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        for (auto& p : hot)
+            receive(*p);
+        std::thread t([&] {
+            for (auto i = 0u; i < msg_ct; ++i)
+                for (auto& p : hot)
+                    p->sc_.send(boost::asio::buffer(&i, sizeof(i)));
+        });
+        ios.run();
+        t.join();
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+        std::cout << (use_epoll ? "epoll" : "asio ") << " reactor: " << idle_ct << " idle, " << hot_ct << " hot sockets, "
+                  << msg_ct * hot_ct << " messages in " << elapsed.count() << "us" << std::endl;
+    };
+
+    run(false);
+    run(true);
+}
+#endif
+
+TEST_CASE( "Events queries per message", "[socket]" ) {
+    boost::asio::io_service ios;
+
+    azmq::socket sb(ios, ZMQ_PAIR, true);
+    sb.set_option(azmq::socket::allow_speculative(false));
+    sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+    azmq::socket sc(ios, ZMQ_PAIR, true);
+    sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+    const size_t ct = 1000;
+    for (auto i = 0u; i < ct; ++i)
+        sc.send(boost::asio::buffer(&i, sizeof(i)));
+
+    size_t received = 0;
+    unsigned value;
+    auto rcv_buf = boost::asio::buffer(&value, sizeof(value));
+    std::function<void()> receive = [&] {
+        sb.async_receive(rcv_buf, [&](boost::system::error_code const& ec, size_t) {
+            if (!ec && ++received < ct)
+                receive();
+        });
+    };
+    receive();
+    ios.run();
+    REQUIRE(received == ct);
+
+    azmq::socket::events_query_count queries;
+    sb.get_option(queries);
+    // one query to schedule each op, the reactor reuses that snapshot
+    REQUIRE(queries.value() <= ct);
+
+    boost::system::error_code ec;
+    sb.set_option(azmq::socket::events_query_count(0), ec);
+    REQUIRE(ec == boost::system::errc::invalid_argument);
+}
+
+TEST_CASE( "Socket counters", "[socket]" ) {
+    boost::asio::io_service ios;
+
+    azmq::socket sb(ios, ZMQ_PAIR);
+    sb.set_option(azmq::socket::allow_speculative(false));
+    sb.set_option(azmq::socket::rcv_hwm(1));
+    sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+    size_t sent = 0;
+    {
+        azmq::socket sc(ios, ZMQ_PAIR);
+        sc.set_option(azmq::socket::snd_hwm(1));
+        sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+        // fill the pipe until the high water mark refuses a send
+        boost::system::error_code ec;
+        unsigned value = 0;
+        while (!ec && sent < 100) {
+            if (sc.send(boost::asio::buffer(&value, sizeof(value)), ZMQ_DONTWAIT, ec))
+                ++sent;
+        }
+        auto err = ec.value();
+        REQUIRE(err == boost::system::errc::resource_unavailable_try_again);
+
+        auto s = sc.stats();
+        REQUIRE(s.frames_sent == sent);
+        REQUIRE(s.bytes_sent == sent * sizeof(value));
+        REQUIRE(s.try_agains == 1);
+        REQUIRE(s.hwm_blocked_sends == 1);
+        REQUIRE(s.frames_received == 0);
+
+        for (auto i = 0u; i < sent; ++i)
+            sb.receive(boost::asio::buffer(&value, sizeof(value)));
+
+        // not speculative, so queued for the reactor, which wakes when sc sends
+        size_t received = 0;
+        sb.async_receive(boost::asio::buffer(&value, sizeof(value)), [&](boost::system::error_code const& ec, size_t) {
+            if (!ec)
+                ++received;
+        });
+        sc.send(boost::asio::buffer(&value, sizeof(value)));
+        ++sent;
+        ios.run();
+        REQUIRE(received == 1);
+    }
+
+    auto s = sb.stats();
+    REQUIRE(s.frames_received == sent);
+    REQUIRE(s.bytes_received == sent * sizeof(unsigned));
+    REQUIRE(s.hwm_blocked_sends == 0);
+    REQUIRE(s.queued_ops == 1);
+    REQUIRE(s.speculative_completions == 0);
+    REQUIRE(s.reactor_wakeups >= 1);
+
+    std::ostringstream plain;
+    plain << sb;
+    REQUIRE(plain.str().find("frames_received=") == std::string::npos);
+
+    std::ostringstream with_stats;
+    with_stats << azmq::show_stats << sb;
+    auto expected = "frames_received=" + std::to_string(sent);
+    REQUIRE(with_stats.str().find(expected) != std::string::npos);
+    with_stats << azmq::noshow_stats;
+    REQUIRE(with_stats.iword(azmq::detail::show_stats_index()) == 0);
+
+    // totals include sc, which has been closed
+    auto total = azmq::get_socket_stats(ios);
+    REQUIRE(total.frames_sent == sent);
+    REQUIRE(total.frames_received == sent);
+    REQUIRE(total.hwm_blocked_sends == 1);
+}
+
+TEST_CASE( "Send/Receive async nocopy", "[socket]" ) {
+    boost::asio::io_service ios;
+
+    azmq::socket sb(ios, ZMQ_PAIR);
+    sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+    azmq::socket sc(ios, ZMQ_PAIR);
+    sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+    std::string a("A part");
+    std::string b("B part");
+    std::array<boost::asio::const_buffer, 2> bufs = {{
+        boost::asio::buffer(a),
+        boost::asio::buffer(b)
+    }};
+
+    bool completed = false;
+    boost::system::error_code ecc;
+    size_t btc = 0;
+    sc.async_send(azmq::nocopy, bufs, [&](boost::system::error_code const& ec, size_t bytes_transferred) {
+        completed = true;
+        ecc = ec;
+        btc = bytes_transferred;
+    });
+    ios.poll();
+    REQUIRE_FALSE(completed);
+
+    {
+        azmq::message_vector msgs;
+        sb.receive_more(msgs, 0);
+        REQUIRE(msgs.size() == 2);
+        REQUIRE(msgs[0].data() == a.data());
+        REQUIRE(msgs[1].data() == b.data());
+
+        // the receiver still refers to the sender's buffers
+        ios.reset();
+        ios.poll();
+        REQUIRE_FALSE(completed);
+    }
+
+    ios.reset();
+    ios.run();
+    REQUIRE(completed);
+    REQUIRE(ecc == boost::system::error_code());
+    REQUIRE(btc == a.size() + b.size());
+}
+
+TEST_CASE( "Send async nocopy outliving io_service", "[socket]" ) {
+    std::string a("A part");
+    auto called = std::make_shared<bool>(false);
+    std::weak_ptr<bool> handler_alive = called;
+    azmq::message_vector msgs;
+    {
+        boost::asio::io_service ios;
+
+        azmq::socket sb(ios, ZMQ_PAIR);
+        sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+        azmq::socket sc(ios, ZMQ_PAIR);
+        sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+        sc.async_send(azmq::nocopy, boost::asio::buffer(a), [called](boost::system::error_code const&, size_t) {
+            *called = true;
+        });
+        sb.receive_more(msgs, 0);
+        REQUIRE(msgs.size() == 1);
+
+        // the frame libzmq still holds is not work, run() does not wait for it
+        ios.run();
+    }
+    called.reset();
+    REQUIRE_FALSE(handler_alive.expired());
+
+    // released after the io_service has gone, the handler is destroyed uncalled
+    msgs.clear();
+    REQUIRE(handler_alive.expired());
+}
+
+TEST_CASE( "Send/Receive async pooled", "[socket]" ) {
+    boost::asio::io_service ios;
+
+    azmq::socket sb(ios, ZMQ_PAIR);
+    sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+    azmq::socket sc(ios, ZMQ_PAIR);
+    sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+    std::string payload(64 * 1024, 'x');
+    sc.send(boost::asio::buffer(payload));
+    sc.send(boost::asio::buffer(payload));
+
+    auto pool = sb.get_message_pool();
+    std::vector<azmq::pooled_message> kept;
+    boost::system::error_code ecb;
+    size_t btb = 0;
+    auto receive = [&] {
+        sb.async_receive_pooled([&](boost::system::error_code const& ec, azmq::pooled_message & msg, size_t bytes_transferred) {
+            ecb = ec;
+            btb += bytes_transferred;
+            kept.push_back(msg);
+        });
+    };
+    receive();
+    receive();
+    ios.run();
+
+    REQUIRE(ecb == boost::system::error_code());
+    REQUIRE(btb == 2 * payload.size());
+    REQUIRE(kept.size() == 2);
+    for (auto& m : kept) {
+        REQUIRE(m.use_count() == 1);
+        REQUIRE(m->string() == payload);
+    }
+    REQUIRE(pool->free_count() == 0);
+
+    kept.clear();
+    REQUIRE(pool->free_count() == 2);
+
+    // subsequent receives reuse the returned messages
+    sc.send(boost::asio::buffer(payload));
+    receive();
+    ios.reset();
+    ios.run();
+    REQUIRE(kept.size() == 1);
+    REQUIRE(pool->free_count() == 1);
+}
+
+TEST_CASE( "Receive multipart async", "[socket]" ) {
+    boost::asio::io_service ios;
+
+    azmq::socket sb(ios, ZMQ_ROUTER);
+    sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+    azmq::socket sc(ios, ZMQ_DEALER);
+    sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+    std::array<boost::asio::const_buffer, 2> snd_bufs = {{
+        boost::asio::buffer(""),
+        boost::asio::buffer("request")
+    }};
+    for (auto i = 0; i != 3; ++i)
+        sc.send(snd_bufs);
+
+    // identity + delimiter + body
+    azmq::multipart_buffer buf(3);
+    std::vector<void const*> slots;
+    for (auto i = 0; i != 2; ++i) {
+        boost::system::error_code ecb;
+        size_t btb = 0;
+        sb.async_receive_multipart(buf, [&](boost::system::error_code const& ec, size_t bytes_transferred) {
+            ecb = ec;
+            btb = bytes_transferred;
+        });
+        ios.reset();
+        ios.run();
+
+        REQUIRE(ecb == boost::system::error_code());
+        REQUIRE(buf.size() == 3);
+        REQUIRE(buf.capacity() == 3);
+        REQUIRE(buf[1].size() == 1);
+        REQUIRE(buf.back().string() == std::string("request", 8));
+        REQUIRE(btb == buf[0].size() + 1 + 8);
+        slots.push_back(&buf[0]);
+    }
+    // the same slots are refilled
+    REQUIRE(slots[0] == slots[1]);
+
+    // parts beyond capacity stay on the socket
+    azmq::multipart_buffer small(2);
+    boost::system::error_code ec;
+    sb.receive_multipart(small, 0, ec);
+    REQUIRE(ec == boost::system::errc::no_buffer_space);
+    REQUIRE(small.size() == 2);
+    azmq::message_vector rest;
+    sb.receive_more(rest, 0);
+    REQUIRE(rest.size() == 1);
+    REQUIRE(rest[0].string() == std::string("request", 8));
+}
+
+TEST_CASE( "Multicast send", "[socket]" ) {
+    boost::asio::io_service ios;
+
+    std::vector<std::unique_ptr<azmq::socket>> senders;
+    std::vector<std::unique_ptr<azmq::socket>> receivers;
+    std::vector<azmq::socket*> targets;
+    for (auto i = 0; i != 3; ++i) {
+        auto ep = subj(BOOST_CURRENT_FUNCTION) + std::to_string(i);
+        receivers.emplace_back(new azmq::socket(ios, ZMQ_PAIR));
+        receivers.back()->set_option(azmq::socket::rcv_hwm(1));
+        receivers.back()->bind(ep);
+        senders.emplace_back(new azmq::socket(ios, ZMQ_PAIR));
+        senders.back()->set_option(azmq::socket::snd_hwm(1));
+        senders.back()->connect(ep);
+        targets.push_back(senders.back().get());
+    }
+
+    std::string payload(1024, 'x');
+    azmq::message msg(boost::asio::buffer(payload));
+    auto res = azmq::multicast_send(targets, msg);
+    REQUIRE(res.errors.size() == 3);
+    REQUIRE(res.sent() == 3);
+    REQUIRE(res.dropped() == 0);
+    REQUIRE(msg.string() == payload);
+
+    for (auto& r : receivers) {
+        azmq::message m;
+        r->receive(m);
+        REQUIRE(m.string() == payload);
+        // every socket was handed the same payload
+        REQUIRE(m.data() == msg.data());
+    }
+
+    // sends don't block at the high water mark, they are reported
+    size_t dropped = 0;
+    for (auto i = 0; i != 100 && !dropped; ++i) {
+        res = azmq::multicast_send(targets, msg);
+        auto total = res.sent() + res.dropped();
+        REQUIRE(total == 3);
+        dropped = res.dropped();
+    }
+    REQUIRE(dropped);
+}
+
+TEST_CASE( "Multicast send async", "[socket]" ) {
+    boost::asio::io_service ios;
+
+    std::vector<azmq::socket> senders;
+    std::vector<azmq::socket> receivers;
+    for (auto i = 0; i != 3; ++i) {
+        auto ep = subj(BOOST_CURRENT_FUNCTION) + std::to_string(i);
+        receivers.emplace_back(ios, ZMQ_PAIR);
+        receivers.back().bind(ep);
+        senders.emplace_back(ios, ZMQ_PAIR);
+        senders.back().connect(ep);
+    }
+
+    std::string payload(1024, 'x');
+    azmq::message msg(boost::asio::buffer(payload));
+    boost::system::error_code ecc;
+    size_t sent = 0;
+    size_t calls = 0;
+    azmq::async_multicast_send(senders, msg, [&](boost::system::error_code const& ec, azmq::multicast_result & res) {
+        ecc = ec;
+        sent = res.sent();
+        ++calls;
+    });
+    ios.run();
+
+    REQUIRE(calls == 1);
+    REQUIRE(ecc == boost::system::error_code());
+    REQUIRE(sent == 3);
+    for (auto& r : receivers) {
+        azmq::message m;
+        r.receive(m);
+        REQUIRE(m.data() == msg.data());
+    }
+
+    // an empty range completes on the io_service given for it, never from
+    // within the initiating call
+    std::vector<azmq::socket*> none;
+    calls = 0;
+    sent = 1;
+    azmq::async_multicast_send(ios, none, msg, [&](boost::system::error_code const& ec, azmq::multicast_result & res) {
+        ecc = ec;
+        sent = res.errors.size();
+        ++calls;
+    });
+    REQUIRE(calls == 0);
+    ios.reset();
+    ios.run();
+    REQUIRE(calls == 1);
+    REQUIRE(ecc == boost::system::error_code());
+    REQUIRE(sent == 0);
+
+    // without one it is refused, the handler is not called
+    REQUIRE_THROWS_AS(azmq::async_multicast_send(none, msg, [&](boost::system::error_code const&, azmq::multicast_result &) {
+        ++calls;
+    }), boost::system::system_error const&);
+    ios.reset();
+    ios.run();
+    REQUIRE(calls == 1);
+}
+
+TEST_CASE( "Send/Receive gather", "[socket]" ) {
+    boost::asio::io_service ios;
+
+    azmq::socket sb(ios, ZMQ_PAIR);
+    sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+    azmq::socket sc(ios, ZMQ_PAIR);
+    sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+    boost::system::error_code ecc;
+    size_t btc = 0;
+    {
+        // the buffers need not outlive initiation
+        std::string hdr("header:");
+        std::string body("body");
+        std::array<boost::asio::const_buffer, 2> bufs = {{
+            boost::asio::buffer(hdr),
+            boost::asio::buffer(body)
+        }};
+        sc.async_send(azmq::gather, bufs, [&](boost::system::error_code const& ec, size_t bytes_transferred) {
+            ecc = ec;
+            btc = bytes_transferred;
+        });
+        sc.send(azmq::gather, bufs);
+    }
+    ios.run();
+    REQUIRE(ecc == boost::system::error_code());
+    REQUIRE(btc == 11);
+
+    for (auto i = 0; i != 2; ++i) {
+        azmq::message m;
+        sb.receive(m);
+        REQUIRE(m.string() == "header:body");
+        REQUIRE_FALSE(m.more());
+    }
+}
+
+TEST_CASE( "Receive ring async", "[socket]" ) {
+    boost::asio::io_service ios;
+
+    azmq::socket sb(ios, ZMQ_PAIR);
+    sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+    azmq::socket sc(ios, ZMQ_PAIR);
+    sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+    // room for three 100 byte frames
+    std::array<char, 3 * 112> region;
+    azmq::frame_ring ring(boost::asio::buffer(region));
+    for (auto i = 0; i != 4; ++i)
+        sc.send(boost::asio::buffer(std::string(100, 'a' + i)));
+
+    boost::system::error_code ecb;
+    size_t frames = 0;
+    size_t btb = 0;
+    auto receive = [&] {
+        sb.async_receive_ring(ring, [&](boost::system::error_code const& ec, size_t f, size_t bytes_transferred) {
+            ecb = ec;
+            frames = f;
+            btb = bytes_transferred;
+        });
+        ios.reset();
+        ios.run();
+    };
+
+    receive();
+    REQUIRE(ecb == boost::system::error_code());
+    REQUIRE(frames == 3);
+    REQUIRE(btb == 300);
+    REQUIRE(ring.frames() == 3);
+
+    // full, the fourth frame is held until there is room
+    receive();
+    REQUIRE(ecb == boost::system::errc::no_buffer_space);
+    REQUIRE(frames == 0);
+
+    REQUIRE(ring.has_pending());
+    std::string seen;
+    ring.consume([&](boost::asio::const_buffer const& b, bool) {
+        seen.push_back(*boost::asio::buffer_cast<char const*>(b));
+    });
+    REQUIRE(seen == "abc");
+
+    // written without waiting for the socket, speculative or not
+    sb.set_option(azmq::socket::allow_speculative(false));
+
+    receive();
+    REQUIRE(ecb == boost::system::error_code());
+    REQUIRE(frames == 1);
+    REQUIRE(*boost::asio::buffer_cast<char const*>(ring.front()) == 'd');
+}
+
+TEST_CASE( "Send async queued buffer sequence", "[socket]" ) {
+    boost::asio::io_service ios;
+
+    azmq::socket sb(ios, ZMQ_PAIR);
+    sb.set_option(azmq::socket::rcv_hwm(1));
+    sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+    azmq::socket sc(ios, ZMQ_PAIR);
+    sc.set_option(azmq::socket::snd_hwm(1));
+    sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+    // fill the pipe so the next send has to be queued
+    size_t queued = 0;
+    boost::system::error_code ec;
+    while (sc.send(boost::asio::buffer("fill"), ZMQ_DONTWAIT, ec), !ec)
+        ++queued;
+    REQUIRE(ec.value() == boost::system::errc::resource_unavailable_try_again);
+
+    std::string a("A part");
+    std::string b("B part");
+    boost::system::error_code ecc;
+    size_t btc = 0;
+    {
+        // the sequence is a temporary, only a and b need to stay valid
+        std::array<boost::asio::const_buffer, 2> bufs = {{
+            boost::asio::buffer(a),
+            boost::asio::buffer(b)
+        }};
+        sc.async_send(bufs, [&](boost::system::error_code const& ec, size_t bytes_transferred) {
+            ecc = ec;
+            btc = bytes_transferred;
+        });
+    }
+    {
+        std::array<boost::asio::const_buffer, 2> junk = {{
+            boost::asio::buffer("junk"),
+            boost::asio::buffer("junk")
+        }};
+        (void)junk;
+    }
+    ios.poll();
+    REQUIRE(btc == 0);
+
+    for (auto i = 0u; i != queued; ++i) {
+        azmq::message m;
+        sb.receive(m);
+    }
+    ios.reset();
+    ios.run();
+    REQUIRE(ecc == boost::system::error_code());
+    REQUIRE(btc == a.size() + b.size());
+
+    azmq::message_vector msgs;
+    sb.receive_more(msgs, 0);
+    REQUIRE(msgs.size() == 2);
+    REQUIRE(msgs[0].string() == a);
+    REQUIRE(msgs[1].string() == b);
+}
+
+#ifdef AZMQ_HAS_MAPPED_FILE
+TEST_CASE( "Send/Receive mapped file", "[socket]" ) {
+    const std::string src_path("azmq_test_mapped_src.bin");
+    const std::string dst_path("azmq_test_mapped_dst.bin");
+    SCOPE_EXIT {
+        std::remove(src_path.c_str());
+        std::remove(dst_path.c_str());
+    };
+
+    const size_t size = 10000;
+    const size_t frame_size = 4096;
+    {
+        auto f = azmq::mapped_file::create(src_path, size);
+        auto buf = boost::asio::buffer_cast<unsigned char*>(f.buffer());
+        for (size_t i = 0; i != size; ++i)
+            buf[i] = static_cast<unsigned char>(i * 7);
+        f.flush();
+    }
+    azmq::mapped_file src(src_path);
+    REQUIRE(src.size() == size);
+    auto dst = azmq::mapped_file::create(dst_path, size);
+
+    boost::asio::io_service ios;
+
+    azmq::socket sb(ios, ZMQ_PAIR);
+    sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+    azmq::socket sc(ios, ZMQ_PAIR);
+    sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+    auto frames = src.frames(frame_size);
+    REQUIRE(frames.size() == 3);
+    size_t sent = 0;
+    for (auto & f : frames) {
+        sc.async_send(f, [&](boost::system::error_code const& ec, size_t bytes_transferred) {
+            REQUIRE(!ec);
+            sent += bytes_transferred;
+        });
+    }
+    frames.clear();
+
+    // received frames are copied straight into the destination mapping
+    size_t received = 0;
+    std::function<void()> receive = [&] {
+        sb.async_receive(boost::asio::buffer(dst.buffer(received, frame_size)), [&](boost::system::error_code const& ec, size_t bytes_transferred) {
+            REQUIRE(!ec);
+            received += bytes_transferred;
+            if (received < size)
+                receive();
+        });
+    };
+    receive();
+    ios.run();
+
+    REQUIRE(sent == size);
+    REQUIRE(received == size);
+    REQUIRE(std::memcmp(src.data(), dst.data(), size) == 0);
+    // all sent frames have been released
+    REQUIRE(src.use_count() == 1);
+}
+#endif
+
+TEST_CASE( "Send/Receive async use_future", "[socket]" ) {
+    boost::asio::io_service ios;
+    boost::asio::io_service::work work(ios);
+    std::thread t([&] { ios.run(); });
+    SCOPE_EXIT {
+        ios.stop();
+        t.join();
+    };
+
+    azmq::socket sb(ios, ZMQ_PAIR);
+    sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+    azmq::socket sc(ios, ZMQ_PAIR);
+    sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+    std::array<char, 5> buf;
+    std::future<size_t> rcv = sb.async_receive(boost::asio::buffer(buf), boost::asio::use_future);
+    std::future<size_t> snd = sc.async_send(boost::asio::buffer("TEST"), boost::asio::use_future);
+    REQUIRE(snd.get() == 5);
+    REQUIRE(rcv.get() == 5);
+    REQUIRE(std::string(buf.data()) == "TEST");
+
+    // handlers receiving a message complete with a copy of it
+    auto msg = sb.async_receive(boost::asio::use_future);
+    sc.async_send(azmq::message("MSG"), boost::asio::use_future).get();
+    auto res = msg.get();
+    REQUIRE(std::get<0>(res).string() == "MSG");
+    REQUIRE(std::get<1>(res) == 3);
+
+    // errors are delivered as exceptions
+    sc.shutdown(azmq::socket::shutdown_type::send);
+    auto err = sc.async_send(boost::asio::buffer("X"), boost::asio::use_future);
+    REQUIRE_THROWS_AS(err.get(), boost::system::system_error const&);
+}
+
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+TEST_CASE( "Send/Receive co_await", "[socket]" ) {
+    boost::asio::io_service ios;
+
+    azmq::socket sb(ios, ZMQ_PAIR);
+    sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+    azmq::socket sc(ios, ZMQ_PAIR);
+    sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+    const int ct = 100;
+    int received = 0;
+    boost::asio::co_spawn(ios, [&]() -> boost::asio::awaitable<void> {
+        for (auto i = 0; i != ct; ++i) {
+            auto [msg, bytes] = co_await sb.async_receive(boost::asio::use_awaitable);
+            REQUIRE(msg.string() == std::to_string(i));
+            ++received;
+        }
+    }, boost::asio::detached);
+    boost::asio::co_spawn(ios, [&]() -> boost::asio::awaitable<void> {
+        for (auto i = 0; i != ct; ++i)
+            co_await sc.async_send(azmq::message(std::to_string(i)), boost::asio::use_awaitable);
+    }, boost::asio::detached);
+    ios.run();
+    REQUIRE(received == ct);
+}
+
+TEST_CASE( "Coroutine/callback receive benchmark", "[.][perf]" ) {
+    const int ct = 1000000;
+    // receive runs the io_service until ct messages have been received
+    auto time = [&](char const* what, std::function<void(boost::asio::io_service &, azmq::socket &)> const& receive) {
+        boost::asio::io_service ios;
+        azmq::socket sb(ios, ZMQ_PAIR);
+        sb.set_option(azmq::socket::rcv_hwm(ct + 1));
+        sb.bind(subj(what));
+        azmq::socket sc(ios, ZMQ_PAIR);
+        sc.set_option(azmq::socket::snd_hwm(ct + 1));
+        sc.connect(subj(what));
+        for (auto i = 0; i != ct; ++i)
+            sc.send(boost::asio::buffer("x", 1));
+
+        auto start = std::chrono::steady_clock::now();
+        receive(ios, sb);
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        std::cout << what << ": " << double(ns) / ct << "ns per message" << std::endl;
+    };
+
+    time("callback", [&](boost::asio::io_service & ios, azmq::socket & s) {
+        auto n = std::make_shared<int>(0);
+        std::function<void()> receive;
+        receive = [&s, n, &receive] {
+            s.async_receive([&receive, n](boost::system::error_code const& ec, azmq::message &, size_t) {
+                if (!ec && ++*n != ct)
+                    receive();
+            });
+        };
+        receive();
+        ios.run();
+    });
+    time("co_await", [&](boost::asio::io_service & ios, azmq::socket & s) {
+        boost::asio::co_spawn(ios, [&]() -> boost::asio::awaitable<void> {
+            for (auto i = 0; i != ct; ++i)
+                co_await s.async_receive(boost::asio::use_awaitable);
+        }, boost::asio::detached);
+        ios.run();
+    });
+}
+#endif
+
+TEST_CASE( "Continuous/re-armed receive benchmark", "[.][perf]" ) {
+    const int ct = 1000000;
+    auto time = [&](char const* what, bool continuous) {
+        boost::asio::io_service ios;
+        azmq::socket sb(ios, ZMQ_PAIR);
+        sb.set_option(azmq::socket::rcv_hwm(ct + 1));
+        sb.bind(subj(what));
+        azmq::socket sc(ios, ZMQ_PAIR);
+        sc.set_option(azmq::socket::snd_hwm(ct + 1));
+        sc.connect(subj(what));
+        for (auto i = 0; i != ct; ++i)
+            sc.send(boost::asio::buffer("x", 1));
+
+        auto start = std::chrono::steady_clock::now();
+        int n = 0;
+        std::function<void()> receive = [&] {
+            sb.async_receive([&](boost::system::error_code const& ec, azmq::message &, size_t) {
+                if (!ec && ++n != ct)
+                    receive();
+            });
+        };
+        if (continuous) {
+            sb.async_receive_continuous([&](boost::system::error_code const& ec, azmq::message &, size_t) {
+                if (!ec && ++n == ct)
+                    sb.cancel();
+            });
+        } else {
+            receive();
+        }
+        ios.run();
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        std::cout << what << ": " << double(ns) / ct << "ns per message" << std::endl;
+    };
+
+    time("re-armed", false);
+    time("continuous", true);
+}
+
+TEST_CASE( "Send copy/nocopy benchmark", "[.][perf]" ) {
+    boost::asio::io_service ios;
+
+    azmq::socket sb(ios, ZMQ_PAIR, true);
+    sb.bind(subj(BOOST_CURRENT_FUNCTION));
+
+    azmq::socket sc(ios, ZMQ_PAIR, true);
+    sc.connect(subj(BOOST_CURRENT_FUNCTION));
+
+    const size_t total = 256 * 1024 * 1024;
+    std::vector<char> payload(16 * 1024 * 1024, 'x');
+    for (size_t size = 64; size <= payload.size(); size *= 4) {
+        auto ct = std::max<size_t>(total / size, 16);
+        if (ct > 100000) ct = 100000;
+        std::array<boost::asio::const_buffer, 1> bufs = {{ boost::asio::buffer(payload.data(), size) }};
+
+        auto run = [&](bool nocopy) {
+            auto start = std::chrono::steady_clock::now();
+            std::thread t([&] {
+                for (auto i = 0u; i < ct; ++i) {
+                    azmq::message msg;
+                    sb.receive(msg);
+                }
+            });
+            for (auto i = 0u; i < ct; ++i) {
+                if (nocopy)
+                    sc.async_send(azmq::nocopy, bufs, [](boost::system::error_code const&, size_t) { });
+                else
+                    sc.async_send(bufs, [](boost::system::error_code const&, size_t) { });
+            }
+            ios.reset();
+            ios.run();
+            t.join();
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        };
+
+        auto copy_us = run(false);
+        auto nocopy_us = run(true);
+        std::cout << size << " bytes x " << ct << ": copy " << copy_us << "us, nocopy " << nocopy_us << "us" << std::endl;
+    }
+}